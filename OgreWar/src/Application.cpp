@@ -16,33 +16,91 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <iostream>
+#include <limits>
 
 #include "Application.hpp"
 
 using namespace std;
 using namespace Ogre;
 
+/// CONSTANTS
+//------------------------------------------------------------------------------
+const Real Application::TICK_RATE = 30.0f;
+const unsigned int Application::MAX_TICKS_PER_FRAME = 5;
+const unsigned int Application::HEADLESS_ORDER_INTERVAL = 300;
+const Real Application::DRAG_THRESHOLD = 0.01f;
+const Real Application::SELECTION_RANGE = 20000.0f;
+const size_t Application::REGIMENT_SIZE = 400;
+const unsigned char Application::PLAYER_FACTION = 0,
+                    Application::ENEMY_FACTION = 1;
+const size_t Application::BLEND_GRAIN = 16;
+// Grass grows above a certain height, but not up cliffs, and fungus creeps in
+// over it higher up still
+const BlendPainter::Rule Application::BLEND_RULES[] =
+{
+  // min height, max height, fade, max slope, fade
+  { 70.0f, numeric_limits<Real>::infinity(), 40.0f, 0.8f, 0.3f },
+  { 70.0f, numeric_limits<Real>::infinity(), 15.0f,
+    numeric_limits<Real>::infinity(), 1.0f }
+};
+const size_t Application::N_BLEND_RULES =
+  sizeof(BLEND_RULES) / sizeof(BLEND_RULES[0]);
+const long Application::MAP_RADIUS = 4;
+const Real Application::VIEW_DISTANCE = 18000.0f;
+const Real Application::PREFETCH_TIME = 3.0f;
+const Real Application::STREAM_INTERVAL = 0.25f;
+const size_t Application::MAX_PAGES_LOADING = 2;
+const size_t Application::DEFAULT_PAGE_BUDGET = 12;
+
 /// CREATION, DESTRUCTION
 //------------------------------------------------------------------------------
 Application::Application() :
 BaseApplication(),
+paths(),
 soldiers(),
-ray_query(NULL),
+clock(1.0f / TICK_RATE, MAX_TICKS_PER_FRAME),
+jobs(),
 r_mouse(false), l_mouse(false),
-focus(Vector3::ZERO),
-gui_renderer()
+formation(Formation::LINE),
+drag_start(Vector2::ZERO),
+dragging(false),
+selection_box(NULL),
+gui_renderer(),
+mTerrainGlobals(NULL),
+mTerrainGroup(NULL),
+mTerrainsImported(false),
+mInfoLabel(NULL),
+terrain_pages(),
+page_ranking(),
+n_pages_resident(0),
+n_pages_ready(0),
+page_budget(DEFAULT_PAGE_BUDGET),
+stream_timer(0.0f),
+last_camera_position(Vector3::ZERO),
+camera_velocity(Vector3::ZERO),
+soldier_positions(),
+heightfield(),
+terrain_cache(),
+height_map(),
+page_heights()
 {
+  // Move orders follow flow fields over the terrain
+  soldiers.setFlowFields(&paths);
 }
 //------------------------------------------------------------------------------
 Application::~Application()
 {
-  // We created the query, and we are also responsible for deleting it.
-  scene->destroyQuery(ray_query);
+  // Delete all the Soldiers while the scene still exists
+  soldiers.clear();
 
-  // Delete all the Soldiers
-  for(SoldierIter i = soldiers.begin(); i != soldiers.end(); i++)
-    delete i->second;
+  // Delete the selection rectangle
+  if(selection_box)
+  {
+    selection_box->detachFromParent();
+    delete selection_box;
+  }
 }
 
 //------------------------------------------------------------------------------
@@ -65,29 +123,17 @@ void Application::createScene()
     mTerrainGlobals = OGRE_NEW Ogre::TerrainGlobalOptions();
 
     mTerrainGroup = OGRE_NEW Ogre::TerrainGroup(scene, Ogre::Terrain::ALIGN_X_Z, 513, 12000.0f);
-    mTerrainGroup->setFilenameConvention(Ogre::String("BasicTutorial3Terrain"), Ogre::String("dat"));
     mTerrainGroup->setOrigin(Ogre::Vector3::ZERO);
 
     configureTerrainDefaults(light);
 
-    for (long x = 0; x <= 0; ++x)
-        for (long y = 0; y <= 0; ++y)
-            defineTerrain(x, y);
-
-    // sync load since we want everything in place when we start
-    mTerrainGroup->loadAllTerrains(true);
+    // Pages are defined and loaded around the camera as it moves, starting
+    // with those it can see straight away
+    last_camera_position = camera->getPosition();
+    streamTerrain(0.0f);
 
-    if (mTerrainsImported)
-    {
-        Ogre::TerrainGroup::TerrainIterator ti = mTerrainGroup->getTerrainIterator();
-        while(ti.hasMoreElements())
-        {
-            Ogre::Terrain* t = ti.getNext()->instance;
-            initBlendMaps(t);
-        }
-    }
-
-    mTerrainGroup->freeTemporaryResources();
+    // Soldiers get Entities and Nodes in this scene
+    soldiers.setSceneManager(scene);
 
 	// CEGUI setup
   gui_renderer = &CEGUI::OgreRenderer::bootstrapSystem();
@@ -95,26 +141,40 @@ void Application::createScene()
   // Mouse
   CEGUI::SchemeManager::getSingleton().create((CEGUI::utf8*)"TaharezLook.scheme");
   CEGUI::MouseCursor::getSingleton().setImage("TaharezLook", "MouseArrow");
+
+  // Selection rectangle, hidden until the player drags
+  selection_box = new SelectionBox("SelectionBox");
+  selection_box->setVisible(false);
+  scene->getRootSceneNode()->attachObject(selection_box);
 }
 //------------------------------------------------------------------------------
 void Application::destroyScene()
 {
+  // Workers may still be painting blend maps
+  for(list<TerrainPage>::iterator page = terrain_pages.begin();
+      page != terrain_pages.end(); page++)
+    jobs.wait(page->batch);
+
   OGRE_DELETE mTerrainGroup;
   OGRE_DELETE mTerrainGlobals;
 }
 //------------------------------------------------------------------------------
 /// QUERY
 //------------------------------------------------------------------------------
-Ray Application::getMouseRay(OIS::MouseState mouse_state) const
+Vector2 Application::getCursorPosition(OIS::MouseState mouse_state) const
 {
-  // Calculate the ray implied by the cursor's position on the screen
+  // Cursor position on the screen, from (0, 0) top-left to (1, 1) bottom-right
   CEGUI::Point mouse_pos = CEGUI::MouseCursor::getSingleton().getPosition();
-  return camera->getCameraToViewportRay(mouse_pos.d_x/float(mouse_state.width),
-                                      mouse_pos.d_y/float(mouse_state.height));
+  return Vector2(mouse_pos.d_x/float(mouse_state.width),
+                 mouse_pos.d_y/float(mouse_state.height));
 }
 //------------------------------------------------------------------------------
 bool Application::getTerrainCollision(Ray ray, Vector3* out)
 {
+  // Descend the cached heights' pyramid rather than stepping along the ray
+  if(!heightfield.isEmpty())
+    return heightfield.getRayCollision(ray, out);
+
   // Perform the scene query
   TerrainGroup::RayResult result = mTerrainGroup->rayIntersects(ray);
   if(result.hit)
@@ -127,34 +187,77 @@ bool Application::getTerrainCollision(Ray ray, Vector3* out)
     return false;
 }
 //------------------------------------------------------------------------------
-bool Application::getSoldierCollision(Ray ray, Soldier** out)
+bool Application::getSoldierCollision(Ray ray, SoldierHandle* out)
 {
-  // Execute the query and return the result
-  ray_query->setRay(ray);
-  RaySceneQueryResult result = ray_query->execute();
-
   // Get the first Soldier collided with
-  for(RaySceneQueryResult::iterator i = result.begin(); i != result.end(); i++)
+  SoldierHandle soldier = soldiers.pick(ray);
+  if(soldier != SoldierStore::NONE)
   {
-    // Ray intersects movable Entity
-    if(i->movable)
-    {
-      // Search for Entity amongst Soldiers
-      SoldierIter soldier_i = soldiers.find(i->movable);
-      if(soldier_i != soldiers.end())
-      {
-        if(out)
-          (*out) = soldier_i->second;
-        return true;
-      }
-    }
+    if(out)
+      (*out) = soldier;
+    return true;
   }
-  return false;
+  else
+    return false;
 }
 //------------------------------------------------------------------------------
 Real Application::getTerrainHeight(Vector3 position)
 {
-  return mTerrainGroup->getHeightAtWorldPosition(position);
+  // Read from the cached heights rather than through the TerrainGroup
+  if(heightfield.isEmpty() && mTerrainGroup)
+    return mTerrainGroup->getHeightAtWorldPosition(position);
+  else
+    return heightfield.getHeightAtWorldPosition(position);
+}
+//------------------------------------------------------------------------------
+bool Application::isTerrainReady(Vector3 position) const
+{
+  // Find the page under the position, if it is loaded and finished
+  long x, y;
+  mTerrainGroup->convertWorldPositionToTerrainSlot(position, &x, &y);
+  for(list<TerrainPage>::const_iterator page = terrain_pages.begin();
+      page != terrain_pages.end(); page++)
+    if(page->x == x && page->y == y)
+      return (page->status == TerrainPage::READY);
+  return false;
+}
+//------------------------------------------------------------------------------
+/// CONTROL
+//------------------------------------------------------------------------------
+void Application::issueOrder(Vector3 destination)
+{
+  // Move selected Soldiers into formation around the destination
+  paths.update(heightfield);
+  soldiers.addFormationToSelected(destination, formation);
+}
+//------------------------------------------------------------------------------
+void Application::setPageBudget(size_t n_pages)
+{
+  // Pages over budget are unloaded the next time the terrain is streamed
+  page_budget = std::max(n_pages, (size_t)1);
+  stream_timer = 0.0f;
+}
+//------------------------------------------------------------------------------
+void Application::selectInBox(Vector2 start, Vector2 end, bool add)
+{
+  // Project the screen rectangle's corners onto the terrain: the footprint is
+  // then matched against the Soldiers' spatial index rather than projecting
+  // every Soldier through the camera
+  Vector2 screen[4] = { start, Vector2(end.x, start.y),
+                        end, Vector2(start.x, end.y) };
+  Vector3 footprint[4];
+  for(int c = 0; c < 4; c++)
+  {
+    Ray ray = camera->getCameraToViewportRay(screen[c].x, screen[c].y);
+    if(!getTerrainCollision(ray, &footprint[c]))
+      // Corners above the horizon reach as far as the player could see
+      footprint[c] = ray.getPoint(SELECTION_RANGE);
+  }
+
+  // Replace the current selection unless asked to add to it
+  if(!add)
+    soldiers.deselectAll();
+  soldiers.selectInside(footprint);
 }
 //------------------------------------------------------------------------------
 /// FRAME LISTENER
@@ -164,9 +267,6 @@ void Application::createFrameListener(void)
   // Listen out from screen refreshes
 	BaseApplication::createFrameListener();
 
-  // Create RaySceneQuery
-  ray_query = scene->createRayQuery(Ogre::Ray());
-
   // Create tray label for terrain information
   mInfoLabel = tray->createLabel(OgreBites::TL_TOP, "TInfo", "", 350);
 }
@@ -179,8 +279,23 @@ bool Application::frameRenderingQueued(const Ogre::FrameEvent &evt)
    return false;
 
 
-  // Save the terrain
-  if (mTerrainGroup->isDerivedDataUpdateInProgress())
+  // Page terrain in and out around the camera, finishing off pages as they
+  // arrive and showing how far along we are
+  streamTerrain(evt.timeSinceLastFrame);
+  updateTerrainPages();
+  saveTerrainPages();
+  if (n_pages_ready < n_pages_resident)
+  {
+      tray->moveWidgetToTray(mInfoLabel, OgreBites::TL_TOP, 0);
+      mInfoLabel->show();
+      mInfoLabel->setCaption("Loading terrain: "
+                             + StringConverter::toString(n_pages_ready) + " of "
+                             + StringConverter::toString(n_pages_resident)
+                             + " pages ready");
+  }
+
+  // Wait for Ogre to finish off the terrain
+  else if (mTerrainGroup->isDerivedDataUpdateInProgress())
   {
       tray->moveWidgetToTray(mInfoLabel, OgreBites::TL_TOP, 0);
       mInfoLabel->show();
@@ -194,24 +309,84 @@ bool Application::frameRenderingQueued(const Ogre::FrameEvent &evt)
   {
       tray->removeWidgetFromTray(mInfoLabel);
       mInfoLabel->hide();
-      if (mTerrainsImported)
-      {
-          mTerrainGroup->saveAllTerrains(true);
-          mTerrainsImported = false;
-      }
   }
 
+  // Redraw the selection rectangle once, however many moves were captured
+  updateSelectionBox();
+
   // Don't fly camera below the terrain
   camera_man->stayAbove(getTerrainHeight(camera->getPosition()) + 20.0f,
                           evt.timeSinceLastFrame);
 
-  // Update the game objects
-  for(SoldierIter i = soldiers.begin(); i != soldiers.end(); i++)
-    i->second->update(evt.timeSinceLastFrame, this);
+  // Update the game objects at a fixed rate, whatever the frame rate
+  unsigned int n_ticks = clock.advance(evt.timeSinceLastFrame);
+  for(unsigned int i = 0; i < n_ticks; i++)
+    tickSimulation(clock.getStep());
+
+  // Draw the game objects part of the way between the last two ticks
+  soldiers.applyToScene(clock.getAlpha(), evt.timeSinceLastFrame);
 
 	return true;
 }
 //------------------------------------------------------------------------------
+void Application::updateFrameInput(InputSnapshot& snapshot)
+{
+  // Follow the CEGUI cursor, as that is the one the player can see
+  snapshot.cursor = getCursorPosition(mouse->getMouseState());
+  snapshot.ray = camera->getCameraToViewportRay(snapshot.cursor.x,
+                                                snapshot.cursor.y);
+
+  // The one terrain query this frame: camera, spawning and orders all share it
+  snapshot.over_terrain = getTerrainCollision(snapshot.ray, &snapshot.focus);
+}
+//------------------------------------------------------------------------------
+void Application::updateSelectionBox()
+{
+  // Start or resize the selection rectangle
+  if(!l_mouse)
+    return;
+
+  const InputSnapshot& input = getFrameInput();
+  if(!dragging && (input.cursor - drag_start).length() > DRAG_THRESHOLD)
+  {
+    dragging = true;
+    selection_box->setVisible(true);
+  }
+  if(dragging)
+    selection_box->setCorners(drag_start, input.cursor);
+}
+//------------------------------------------------------------------------------
+/// SIMULATION
+//------------------------------------------------------------------------------
+void Application::tickSimulation(Real d_time)
+{
+  paths.update(heightfield);
+  soldiers.tick(d_time, heightfield, jobs);
+}
+//------------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+
+/// KEY LISTENER
+//------------------------------------------------------------------------------
+bool Application::keyPressed(const OIS::KeyEvent &evt)
+{
+  // Base application logic
+  if(!BaseApplication::keyPressed(evt))
+    return false;
+
+  // Choose the formation for the next orders
+  if(evt.key == OIS::KC_1)
+    formation = Formation(Formation::LINE);
+  else if(evt.key == OIS::KC_2)
+    formation = Formation(Formation::COLUMN);
+  else if(evt.key == OIS::KC_3)
+    formation = Formation(Formation::WEDGE);
+  else if(evt.key == OIS::KC_4)
+    formation = Formation(Formation::SQUARE);
+
+  return true;
+}
+//------------------------------------------------------------------------------
 
 /// MOUSE LISTENER
 //------------------------------------------------------------------------------
@@ -221,9 +396,7 @@ bool Application::mouseMoved(const OIS::MouseEvent &evt)
   if(!BaseApplication::mouseMoved(evt))
     return false;
 
-  // Find point that cursor is pointing to
-  getTerrainCollision(getMouseRay(evt.state), &focus);
-
+  // Picking waits for the frame: only the last of this frame's moves matters
 
   // Update CEGUI with the mouse motion
   CEGUI::System::getSingleton().injectMouseMove(evt.state.X.rel, evt.state.Y.rel);
@@ -241,18 +414,10 @@ bool Application::mousePressed(const OIS::MouseEvent &evt, OIS::MouseButtonID id
   // Left mouse button down
   if (id == OIS::MB_Left)
   {
-    // Set mouse state
+    // Set mouse state: clicking or dragging is decided on release
     l_mouse = true;
-
-    // Select Soldiers under cursor
-    Soldier* selection;
-    if(getSoldierCollision(getMouseRay(evt.state), &selection))
-      selection->setSelected(!selection->isSelected());
-    else
-      // Move Soldiers to empty area if nothing to select
-      for(SoldierIter i = soldiers.begin(); i != soldiers.end(); i++)
-        if(i->second->isSelected())
-          i->second->addWaypoint(focus);
+    dragging = false;
+    drag_start = getFrameInput().cursor;
   }
 
   // Right mouse button down
@@ -261,9 +426,20 @@ bool Application::mousePressed(const OIS::MouseEvent &evt, OIS::MouseButtonID id
     // Set mouse state
     r_mouse = true;
 
-    // Create a new Soldier
-    Soldier* new_soldier = new Soldier();
-    new_soldier->attach(soldiers, scene, focus);
+    // Only stand Soldiers on ground that has finished loading
+    const InputSnapshot& input = getFrameInput();
+    if(!input.over_terrain || !isTerrainReady(input.focus))
+      return true;
+
+    // Create a whole regiment at once, or a single new Soldier: hold Ctrl to
+    // create enemies instead
+    unsigned char faction = keyboard->isModifierDown(OIS::Keyboard::Ctrl)
+                          ? ENEMY_FACTION : PLAYER_FACTION;
+    if(keyboard->isModifierDown(OIS::Keyboard::Shift))
+      soldiers.spawnRegiment(REGIMENT_SIZE, input.focus, Formation(),
+                             heightfield, faction);
+    else
+      soldiers.create(input.focus, faction);
   }
 
   // consume event
@@ -276,11 +452,35 @@ bool Application::mouseReleased(const OIS::MouseEvent &evt, OIS::MouseButtonID i
   if(!BaseApplication::mouseReleased(evt, id))
     return false;
 
-  // Left mouse button down
+  // Left mouse button up
   if (id == OIS::MB_Left)
+  {
+    // Set mouse state
     l_mouse = false;
 
-  // Right mouse button down
+    // Select all Soldiers inside the rectangle: the box may not have been
+    // drawn yet if the drag and release arrived in the same frame
+    const InputSnapshot& input = getFrameInput();
+    if(dragging || (input.cursor - drag_start).length() > DRAG_THRESHOLD)
+    {
+      dragging = false;
+      selection_box->setVisible(false);
+      selectInBox(drag_start, input.cursor,
+                  keyboard->isModifierDown(OIS::Keyboard::Shift));
+    }
+    else
+    {
+      // Select Soldiers under cursor
+      SoldierHandle selection;
+      if(getSoldierCollision(input.ray, &selection))
+        soldiers.setSelected(selection, !soldiers.isSelected(selection));
+      else if(input.over_terrain)
+        // Move Soldiers to empty area if nothing to select
+        issueOrder(input.focus);
+    }
+  }
+
+  // Right mouse button up
   else if (id == OIS::MB_Right)
     r_mouse = false;
 
@@ -291,10 +491,15 @@ bool Application::mouseReleased(const OIS::MouseEvent &evt, OIS::MouseButtonID i
 
 /// TERRAIN
 
+static const char* HEIGHT_MAP = "height_map.png";
+static const char* HEIGHT_MAP_RAW[] = { "height_map.r16", "height_map.r32" };
+static const size_t N_HEIGHT_MAPS_RAW =
+  sizeof(HEIGHT_MAP_RAW) / sizeof(HEIGHT_MAP_RAW[0]);
+
 /// FIXME
 void getTerrainImage(bool flipX, bool flipY, Ogre::Image& img)
 {
-  img.load("height_map.png", Ogre::ResourceGroupManager::AUTODETECT_RESOURCE_GROUP_NAME);
+  img.load(HEIGHT_MAP, Ogre::ResourceGroupManager::AUTODETECT_RESOURCE_GROUP_NAME);
   if (flipX)
       img.flipAroundY();
   if (flipY)
@@ -302,53 +507,283 @@ void getTerrainImage(bool flipX, bool flipY, Ogre::Image& img)
 }
 
 //------------------------------------------------------------------------------
-void Application::defineTerrain(long x, long y)
+bool Application::openHeightMap(const Ogre::Terrain::ImportData& settings)
+{
+  // Prefer a 16- or 32-bit map to the 8-bit image, if pages can be cut from it
+  for (size_t i = 0; i < N_HEIGHT_MAPS_RAW; i++)
+  {
+    if (!height_map.openResource(HEIGHT_MAP_RAW[i],
+          Ogre::ResourceGroupManager::AUTODETECT_RESOURCE_GROUP_NAME))
+      continue;
+    if (height_map.fitsPages(settings.terrainSize))
+      return true;
+    Ogre::LogManager::getSingleton().logMessage(Ogre::String(HEIGHT_MAP_RAW[i])
+      + " does not split into pages of "
+      + StringConverter::toString(settings.terrainSize) + ", ignoring it");
+    height_map.close();
+  }
+  return false;
+}
+//------------------------------------------------------------------------------
+bool Application::defineTerrain(long x, long y)
 {
   Ogre::String filename = mTerrainGroup->generateFilename(x, y);
   if (Ogre::ResourceGroupManager::getSingleton().resourceExists(mTerrainGroup->getResourceGroup(), filename))
   {
       mTerrainGroup->defineTerrain(x, y);
+      return false;
   }
   else
   {
-      Ogre::Image img;
-      getTerrainImage(x % 2 != 0, y % 2 != 0, img);
-      mTerrainGroup->defineTerrain(x, y, &img);
+      if (height_map.isOpen())
+      {
+        // Straight out of the mapped file, with no image to decode
+        size_t size = mTerrainGroup->getTerrainSize();
+        page_heights.resize(size * size);
+        height_map.readPage(x, y, size, &page_heights[0]);
+        mTerrainGroup->defineTerrain(x, y, &page_heights[0]);
+      }
+      else
+      {
+        Ogre::Image img;
+        getTerrainImage(x % 2 != 0, y % 2 != 0, img);
+        mTerrainGroup->defineTerrain(x, y, &img);
+      }
       mTerrainsImported = true;
+      return true;
   }
 }
 //------------------------------------------------------------------------------
-void Application::initBlendMaps(Ogre::Terrain* terrain)
+Application::TerrainPage* Application::findTerrainPage(long x, long y)
+{
+  for(list<TerrainPage>::iterator page = terrain_pages.begin();
+      page != terrain_pages.end(); page++)
+    if(page->x == x && page->y == y)
+      return &(*page);
+  return NULL;
+}
+//------------------------------------------------------------------------------
+void Application::streamTerrain(Real d_time)
 {
-  Ogre::TerrainLayerBlendMap* blendMap0 = terrain->getLayerBlendMap(1);
-  Ogre::TerrainLayerBlendMap* blendMap1 = terrain->getLayerBlendMap(2);
-  Ogre::Real minHeight0 = 70;
-  Ogre::Real fadeDist0 = 40;
-  Ogre::Real minHeight1 = 70;
-  Ogre::Real fadeDist1 = 15;
-  float* pBlend0 = blendMap0->getBlendPointer();
-  float* pBlend1 = blendMap1->getBlendPointer();
-  for (Ogre::uint16 y = 0; y < terrain->getLayerBlendMapSize(); ++y)
+  // Reconsider which pages should be resident a few times a second
+  stream_timer -= d_time;
+  if (stream_timer > 0.0f)
+    return;
+  Real elapsed = STREAM_INTERVAL - stream_timer;
+  stream_timer = STREAM_INTERVAL;
+
+  // Look ahead along the camera's movement, to have pages in before they show
+  Vector3 camera_position = camera->getPosition();
+  camera_velocity = (camera_position - last_camera_position) / elapsed;
+  last_camera_position = camera_position;
+  Vector3 ahead = camera_position + camera_velocity * PREFETCH_TIME;
+
+  // Soldiers need the ground under them: awake ones most of all
+  long side = 2 * MAP_RADIUS + 1;
+  vector<unsigned char> occupied(side * side, 0);
+  for (int awake = 0; awake < 2; awake++)
+  {
+    soldiers.getPositions(soldier_positions, awake != 0);
+    for (size_t i = 0; i < soldier_positions.size(); i++)
+    {
+      long x, y;
+      mTerrainGroup->convertWorldPositionToTerrainSlot(soldier_positions[i],
+                                                       &x, &y);
+      if (x >= -MAP_RADIUS && x <= MAP_RADIUS
+      && y >= -MAP_RADIUS && y <= MAP_RADIUS)
+      {
+        unsigned char& o = occupied[(y + MAP_RADIUS) * side + x + MAP_RADIUS];
+        o = std::max(o, (unsigned char)(awake + 1));
+      }
+    }
+  }
+
+  // Rank the pages of the map: under awake Soldiers first, then under
+  // sleeping ones, then those near the camera now or soon
+  page_ranking.clear();
+  for (long y = -MAP_RADIUS; y <= MAP_RADIUS; y++)
+    for (long x = -MAP_RADIUS; x <= MAP_RADIUS; x++)
+    {
+      Vector3 centre;
+      mTerrainGroup->convertTerrainSlotToWorldPosition(x, y, &centre);
+      Vector2 flat(centre.x, centre.z);
+      Real distance = std::min(
+        flat.distance(Vector2(camera_position.x, camera_position.z)),
+        flat.distance(Vector2(ahead.x, ahead.z)));
+      unsigned char o = occupied[(y + MAP_RADIUS) * side + x + MAP_RADIUS];
+      Real priority = (o == 2) ? 0.0f
+                    : (distance < VIEW_DISTANCE) ? distance
+                    : (o == 1) ? VIEW_DISTANCE : Math::POS_INFINITY;
+
+      // Pages are defined the first time they are wanted
+      TerrainPage* page = findTerrainPage(x, y);
+      if (!page)
+      {
+        if (priority == Math::POS_INFINITY)
+          continue;
+        terrain_pages.emplace_back();
+        page = &terrain_pages.back();
+        page->x = x;
+        page->y = y;
+        page->status = TerrainPage::UNLOADED;
+        page->imported = false;
+      }
+      page->priority = priority;
+      page->occupied = (o != 0);
+      page_ranking.push_back(page);
+    }
+  std::sort(page_ranking.begin(), page_ranking.end(), isMoreWanted);
+
+  // Only so many pages fit in the budget, and only so many load at once.
+  // The ground under Soldiers is wanted whatever the budget says.
+  size_t n_wanted = 0, n_busy = 0, n_loads = 0;
+  while (n_wanted < page_ranking.size()
+  && (n_wanted < page_budget || page_ranking[n_wanted]->occupied)
+  && page_ranking[n_wanted]->priority < Math::POS_INFINITY)
+    n_wanted++;
+  for (size_t rank = 0; rank < page_ranking.size(); rank++)
+  {
+    TerrainPage::Status status = page_ranking[rank]->status;
+    if (status == TerrainPage::LOADING || status == TerrainPage::BLENDING)
+      n_busy++;
+    else if (status == TerrainPage::UNLOADED && rank < n_wanted)
+      n_loads++;
+  }
+  n_loads = std::min(n_loads, (n_busy < MAX_PAGES_LOADING)
+                              ? MAX_PAGES_LOADING - n_busy : 0);
+
+  // Make room by unloading the least wanted pages, as long as they are done
+  // with and safely saved. Others stay resident until the budget is hit.
+  // Never pull the ground from under Soldiers, even sleeping ones: they would
+  // drop to zero, if not now then as soon as they wake.
+  for (size_t rank = page_ranking.size();
+       rank > n_wanted && n_pages_resident + n_loads > page_budget; rank--)
+  {
+    TerrainPage& page = *page_ranking[rank - 1];
+    if (page.status == TerrainPage::READY && !page.imported && !page.occupied
+    && !terrain_cache.isWriting(mTerrainGroup->generateFilename(page.x, page.y)))
+      unloadTerrainPage(page);
+  }
+
+  // Then load the most wanted missing pages in the background
+  for (size_t rank = 0; rank < n_wanted && n_loads > 0
+       && (n_pages_resident < page_budget || page_ranking[rank]->occupied);
+       rank++)
+    if (page_ranking[rank]->status == TerrainPage::UNLOADED)
+    {
+      loadTerrainPage(*page_ranking[rank]);
+      n_loads--;
+    }
+}
+//------------------------------------------------------------------------------
+bool Application::isMoreWanted(const TerrainPage* a, const TerrainPage* b)
+{
+  // Pages under Soldiers come first, even level with the camera's
+  if (a->occupied != b->occupied)
+    return a->occupied;
+  return a->priority < b->priority;
+}
+//------------------------------------------------------------------------------
+void Application::loadTerrainPage(TerrainPage& page)
+{
+  // Define afresh each time: import data is spent once loaded, and the page
+  // may have been saved since
+  page.imported = defineTerrain(page.x, page.y);
+  mTerrainGroup->loadTerrain(page.x, page.y, false);
+  page.status = TerrainPage::LOADING;
+  n_pages_resident++;
+}
+//------------------------------------------------------------------------------
+void Application::unloadTerrainPage(TerrainPage& page)
+{
+  // The simulation loses the heights along with the renderable page
+  Vector3 centre;
+  mTerrainGroup->convertTerrainSlotToWorldPosition(page.x, page.y, &centre);
+  heightfield.removePage(centre);
+  mTerrainGroup->unloadTerrain(page.x, page.y);
+  page.status = TerrainPage::UNLOADED;
+  n_pages_resident--;
+  n_pages_ready--;
+}
+//------------------------------------------------------------------------------
+void Application::updateTerrainPages()
+{
+  if (n_pages_ready == n_pages_resident)
+    return;
+
+  for(list<TerrainPage>::iterator page = terrain_pages.begin();
+      page != terrain_pages.end(); page++)
   {
-    for (Ogre::uint16 x = 0; x < terrain->getLayerBlendMapSize(); ++x)
+    Ogre::Terrain* terrain = mTerrainGroup->getTerrain(page->x, page->y);
+
+    // Imported pages have their blend maps painted on the workers, in bands
+    // of rows
+    if (page->status == TerrainPage::LOADING && terrain && terrain->isLoaded())
+    {
+      if (page->imported)
+      {
+        page->blend.setup(terrain, BLEND_RULES, N_BLEND_RULES);
+        jobs.submit(page->blend, page->blend.getRowCount(), BLEND_GRAIN,
+                    page->batch);
+        page->status = TerrainPage::BLENDING;
+      }
+      else
+        page->status = TerrainPage::READY;
+    }
+
+    // Upload the painted blend maps, which starts Ogre on the composite map
+    // and other derived data in its own background thread
+    else if (page->status == TerrainPage::BLENDING && page->batch.isDone())
     {
-      Ogre::Real tx, ty;
+      for (size_t layer = 1; layer <= N_BLEND_RULES; layer++)
+      {
+        Ogre::TerrainLayerBlendMap* blend_map =
+          terrain->getLayerBlendMap((Ogre::uint8)layer);
+        blend_map->dirty();
+        blend_map->update();
+      }
+      page->status = TerrainPage::READY;
+    }
+    else
+      continue;
 
-      blendMap0->convertImageToTerrainSpace(x, y, &tx, &ty);
-      Ogre::Real height = terrain->getHeightAtTerrainPosition(tx, ty);
-      Ogre::Real val = (height - minHeight0) / fadeDist0;
-      val = Ogre::Math::Clamp(val, (Ogre::Real)0, (Ogre::Real)1);
-      *pBlend0++ = val;
+    // Keep a flat copy of the heights for cheap, thread-safe queries
+    if (page->status == TerrainPage::READY)
+    {
+      n_pages_ready++;
+      heightfield.copyFrom(terrain);
+    }
+  }
 
-      val = (height - minHeight1) / fadeDist1;
-      val = Ogre::Math::Clamp(val, (Ogre::Real)0, (Ogre::Real)1);
-      *pBlend1++ = val;
+  // Import data is only needed until every resident page is in
+  if (n_pages_ready == n_pages_resident)
+    mTerrainGroup->freeTemporaryResources();
+}
+//------------------------------------------------------------------------------
+void Application::saveTerrainPages()
+{
+  if (!mTerrainsImported)
+    return;
+
+  // Save each imported page once Ogre is done deriving its lightmap and
+  // composite map, so that it is loaded rather than imported next time
+  mTerrainsImported = false;
+  for(list<TerrainPage>::iterator page = terrain_pages.begin();
+      page != terrain_pages.end(); page++)
+  {
+    if (!page->imported)
+      continue;
+    Ogre::Terrain* terrain = mTerrainGroup->getTerrain(page->x, page->y);
+    if (page->status == TerrainPage::READY
+    && !terrain->isDerivedDataUpdateInProgress())
+    {
+      terrain_cache.save(terrain, mTerrainGroup->generateFilename(page->x, page->y),
+                         mTerrainGroup->getResourceGroup());
+      page->imported = false;
     }
+    else
+      mTerrainsImported = true;
   }
-  blendMap0->dirty();
-  blendMap1->dirty();
-  blendMap0->update();
-  blendMap1->update();
 }
 //------------------------------------------------------------------------------
 void Application::configureTerrainDefaults(Ogre::Light* light)
@@ -362,10 +797,40 @@ void Application::configureTerrainDefaults(Ogre::Light* light)
   mTerrainGlobals->setCompositeMapAmbient(scene->getAmbientLight());
   mTerrainGlobals->setCompositeMapDiffuse(light->getDiffuseColour());
   // Configure default import settings for if we use imported image
-  Ogre::Terrain::ImportData& defaultimp = mTerrainGroup->getDefaultImportSettings();
+  configureImportSettings(mTerrainGroup->getDefaultImportSettings());
+
+  // Name saved pages after everything that goes into them, so that editing
+  // any of it has the pages imported afresh rather than loaded stale
+  terrain_cache.resetKey();
+  if (openHeightMap(mTerrainGroup->getDefaultImportSettings()))
+  {
+    // Size and date stand in for the contents, which could be hundreds of
+    // megabytes to read through on every start
+    RawHeightMap::Format format = height_map.getFormat();
+    size_t n_bytes = height_map.getByteCount();
+    unsigned long long modified = height_map.getModifiedTime();
+    terrain_cache.hashBytes(&format, sizeof(format));
+    terrain_cache.hashBytes(&n_bytes, sizeof(n_bytes));
+    terrain_cache.hashBytes(&modified, sizeof(modified));
+  }
+  else
+    terrain_cache.hashResource(HEIGHT_MAP,
+      Ogre::ResourceGroupManager::AUTODETECT_RESOURCE_GROUP_NAME);
+  terrain_cache.hashImportSettings(mTerrainGroup->getDefaultImportSettings());
+  terrain_cache.hashBytes(BLEND_RULES, N_BLEND_RULES * sizeof(BLEND_RULES[0]));
+  terrain_cache.hashBytes(&light->getDerivedDirection(), sizeof(Ogre::Vector3));
+  terrain_cache.hashBytes(&scene->getAmbientLight(), sizeof(Ogre::ColourValue));
+  terrain_cache.hashBytes(&light->getDiffuseColour(), sizeof(Ogre::ColourValue));
+  mTerrainGroup->setFilenameConvention(terrain_cache.getPrefix("OgreWarTerrain"),
+                                       Ogre::String("dat"));
+  terrain_cache.prune("OgreWarTerrain", "dat", mTerrainGroup->getResourceGroup());
+}
+//------------------------------------------------------------------------------
+void Application::configureImportSettings(Ogre::Terrain::ImportData& defaultimp)
+{
   defaultimp.terrainSize = 513;
   defaultimp.worldSize = 12000.0f;
-  defaultimp.inputScale = 600; // due terrain.png is 8 bpp
+  defaultimp.inputScale = 600; // heightmaps are read as 0 to 1
   defaultimp.minBatchSize = 33;
   defaultimp.maxBatchSize = 65;
   // textures
@@ -380,3 +845,61 @@ void Application::configureTerrainDefaults(Ogre::Light* light)
     defaultimp.layerList[2].textureNames.push_back("growth_weirdfungus-03_diffusespecular.dds");
     defaultimp.layerList[2].textureNames.push_back("growth_weirdfungus-03_normalheight.dds");
 }
+//------------------------------------------------------------------------------
+
+/// HEADLESS SIMULATION
+//------------------------------------------------------------------------------
+void Application::goHeadless(unsigned int n_soldiers, unsigned int n_ticks)
+{
+  locateConfiguration();
+
+  // Only the resource system is needed: no plugins, window, input or GUI
+  root = new Ogre::Root("", "", "OgreWarHeadless.log");
+  setupResources();
+
+  // Load the terrain heights without creating any renderable terrain
+  Ogre::Terrain::ImportData import_settings;
+  configureImportSettings(import_settings);
+  if(openHeightMap(import_settings))
+  {
+    size_t size = import_settings.terrainSize;
+    page_heights.resize(size * size);
+    height_map.readPage(0, 0, size, &page_heights[0]);
+    heightfield.import(&page_heights[0], import_settings);
+  }
+  else
+  {
+    Ogre::Image img;
+    getTerrainImage(false, false, img);
+    heightfield.import(img, import_settings);
+  }
+
+  // Scatter selected Soldiers over the middle of the terrain
+  Real spread = import_settings.worldSize * 0.25f;
+  soldiers.reserve(n_soldiers);
+  for(unsigned int i = 0; i < n_soldiers; i++)
+  {
+    Vector3 position(Math::RangeRandom(-spread, spread), 0.0f,
+                     Math::RangeRandom(-spread, spread));
+    position.y = getTerrainHeight(position);
+    soldiers.setSelected(soldiers.create(position), true);
+  }
+
+  // Tick the simulation as fast as possible, issuing an order now and then
+  Ogre::Timer timer;
+  for(unsigned int tick = 0; tick < n_ticks; tick++)
+  {
+    if(tick % HEADLESS_ORDER_INTERVAL == 0)
+      issueOrder(Vector3(Math::RangeRandom(-spread, spread), 0.0f,
+                          Math::RangeRandom(-spread, spread)));
+    tickSimulation(clock.getStep());
+  }
+  unsigned long elapsed = timer.getMicroseconds();
+
+  // Report simulation throughput
+  double seconds = elapsed / 1000000.0;
+  cout << n_soldiers << " soldiers, " << n_ticks << " ticks on "
+       << jobs.getThreadCount() << " threads in " << seconds
+       << "s: " << (seconds > 0 ? n_ticks / seconds : 0) << " ticks/s, "
+       << (n_ticks ? elapsed / double(n_ticks) : 0) << "us/tick" << endl;
+}
@@ -20,6 +20,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define APPLICATION_HPP_INCLUDED
 
 #include <list>
+#include <vector>
 
 #include <CEGUI/CEGUI.h>
 #include <CEGUI/RendererModules/Ogre/CEGUIOgreRenderer.h>
@@ -28,22 +29,82 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <OGRE/Terrain/OgreTerrainGroup.h>
 
 #include "BaseApplication.h"
-#include "Soldier.hpp"
+#include "BlendPainter.hpp"
+#include "FlowFieldCache.hpp"
+#include "HeightField.hpp"
+#include "JobSystem.hpp"
+#include "RawHeightMap.hpp"
+#include "SelectionBox.hpp"
+#include "SimulationClock.hpp"
+#include "SoldierStore.hpp"
+#include "TerrainCache.hpp"
 
 class Application : public BaseApplication
 {
+  /// CONSTANTS
+private:
+  static const Ogre::Real TICK_RATE;
+  static const unsigned int MAX_TICKS_PER_FRAME;
+  static const unsigned int HEADLESS_ORDER_INTERVAL;
+  static const Ogre::Real DRAG_THRESHOLD;
+  static const Ogre::Real SELECTION_RANGE;
+  static const size_t REGIMENT_SIZE;
+  static const unsigned char PLAYER_FACTION, ENEMY_FACTION;
+  static const size_t BLEND_GRAIN;
+  static const BlendPainter::Rule BLEND_RULES[];
+  static const size_t N_BLEND_RULES;
+  static const long MAP_RADIUS;
+  static const Ogre::Real VIEW_DISTANCE;
+  static const Ogre::Real PREFETCH_TIME;
+  static const Ogre::Real STREAM_INTERVAL;
+  static const size_t MAX_PAGES_LOADING;
+  static const size_t DEFAULT_PAGE_BUDGET;
+
+  /// NESTING
+private:
+  // A page of the TerrainGroup, followed from loading until it is playable
+  // and then until it is unloaded again
+  struct TerrainPage
+  {
+    enum Status { UNLOADED, LOADING, BLENDING, READY };
+    long x, y;
+    Status status;
+    bool imported;                      // True until saved to disk
+    Ogre::Real priority;                // Lowest is most wanted
+    bool occupied;                      // Soldiers stand on it
+    BlendPainter blend;
+    JobSystem::Batch batch;
+  };
+
   /// ATTRIBUTES
 private:
-  SoldierMap soldiers;
-  Ogre::RaySceneQuery *ray_query;       // The ray scene query pointer
+  FlowFieldCache paths;                 // Shared routes for move orders
+  SoldierStore soldiers;
+  SimulationClock clock;                // Fixed-rate simulation ticks
+  JobSystem jobs;                       // Worker threads for simulation
   bool r_mouse, l_mouse;		            // True if the mouse buttons are down
-  Ogre::Vector3 focus;                  // Position of the cursor in the world
+  Formation formation;                  // Shape taken up by move orders
+  Ogre::Vector2 drag_start;             // Cursor position when left went down
+  bool dragging;                        // True while drawing a selection box
+  SelectionBox* selection_box;          // Rectangle drawn while dragging
   CEGUI::Renderer *gui_renderer;		    // CEGUI renderer
   // terrain
   Ogre::TerrainGlobalOptions* mTerrainGlobals;
   Ogre::TerrainGroup* mTerrainGroup;
   bool mTerrainsImported;
   OgreBites::Label* mInfoLabel;
+  std::list<TerrainPage> terrain_pages; // Loaded in the background
+  std::vector<TerrainPage*> page_ranking; // Most wanted pages first
+  size_t n_pages_resident, n_pages_ready;
+  size_t page_budget;                   // Most pages to keep in memory
+  Ogre::Real stream_timer;              // Until pages are next reconsidered
+  Ogre::Vector3 last_camera_position;
+  Ogre::Vector3 camera_velocity;        // Pages are fetched ahead of it
+  std::vector<Ogre::Vector3> soldier_positions;
+  HeightField heightfield;              // Flat copy of the terrain heights
+  TerrainCache terrain_cache;           // Imported pages, saved for next time
+  RawHeightMap height_map;              // Mapped 16-bit heights, if any
+  std::vector<float> page_heights;      // One page's worth, cut from the map
 
   /// METHODS
 public:
@@ -51,11 +112,17 @@ public:
   Application();
   virtual ~Application();
   void destroyScene();
+  void goHeadless(unsigned int n_soldiers, unsigned int n_ticks);
   // query
-  Ogre::Ray getMouseRay(OIS::MouseState mouse_state) const;
+  Ogre::Vector2 getCursorPosition(OIS::MouseState mouse_state) const;
   bool getTerrainCollision(Ogre::Ray ray, Ogre::Vector3* out = NULL);
-  bool getSoldierCollision(Ogre::Ray ray, Soldier** out = NULL);
+  bool getSoldierCollision(Ogre::Ray ray, SoldierHandle* out = NULL);
   Ogre::Real getTerrainHeight(Ogre::Vector3 position);
+  bool isTerrainReady(Ogre::Vector3 position) const;
+  // control
+  void issueOrder(Ogre::Vector3 destination);
+  void setPageBudget(size_t n_pages);
+  void selectInBox(Ogre::Vector2 start, Ogre::Vector2 end, bool add);
 
   /// SUBROUTINES
 protected:
@@ -64,14 +131,28 @@ protected:
   // frame listener
   virtual void createFrameListener();
   virtual bool frameRenderingQueued(const Ogre::FrameEvent &evt);
+  virtual void updateFrameInput(InputSnapshot& snapshot);
+  void updateSelectionBox();
+  // simulation
+  void tickSimulation(Ogre::Real d_time);
+  // key listener
+  virtual bool keyPressed(const OIS::KeyEvent &evt);
   // mouse listener
   virtual bool mouseMoved(const OIS::MouseEvent &evt);
   virtual bool mousePressed(const OIS::MouseEvent &evt,OIS::MouseButtonID id);
   virtual bool mouseReleased(const OIS::MouseEvent &evt,OIS::MouseButtonID id);
   // terrain
-  void defineTerrain(long x, long y);
-  void initBlendMaps(Ogre::Terrain* terrain);
+  bool openHeightMap(const Ogre::Terrain::ImportData& settings);
+  bool defineTerrain(long x, long y);
+  TerrainPage* findTerrainPage(long x, long y);
+  void streamTerrain(Ogre::Real d_time);
+  void loadTerrainPage(TerrainPage& page);
+  void unloadTerrainPage(TerrainPage& page);
+  static bool isMoreWanted(const TerrainPage* a, const TerrainPage* b);
+  void updateTerrainPages();
+  void saveTerrainPages();
   void configureTerrainDefaults(Ogre::Light* light);
+  void configureImportSettings(Ogre::Terrain::ImportData& defaultimp);
 };
 
 #endif // APPLICATION_HPP_INCLUDED
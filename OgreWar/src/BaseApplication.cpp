@@ -35,7 +35,9 @@ plugins_cfg(Ogre::StringUtil::BLANK),
 //OIS Input devices
 input(NULL),
 mouse(NULL),
-keyboard(NULL)
+keyboard(NULL),
+frame_input(),
+frame_input_stale(true)
 {
 }
 
@@ -200,7 +202,29 @@ void BaseApplication::loadResources(void)
   Ogre::ResourceGroupManager::getSingleton().initialiseAllResourceGroups();
 }
 //------------------------------------------------------------------------------
-void BaseApplication::go(void)
+const InputSnapshot& BaseApplication::getFrameInput(void)
+{
+  // Mouse events only mark the snapshot stale: it is taken again the first
+  // time it is asked for after that, so at most once per frame for motion
+  if (frame_input_stale)
+  {
+    updateFrameInput(frame_input);
+    frame_input_stale = false;
+  }
+  return frame_input;
+}
+//------------------------------------------------------------------------------
+void BaseApplication::updateFrameInput(InputSnapshot& snapshot)
+{
+  const OIS::MouseState &ms = mouse->getMouseState();
+  snapshot.cursor = Ogre::Vector2(ms.X.abs / float(ms.width),
+                                  ms.Y.abs / float(ms.height));
+  snapshot.ray = camera->getCameraToViewportRay(snapshot.cursor.x,
+                                                snapshot.cursor.y);
+  snapshot.over_terrain = false;
+}
+//------------------------------------------------------------------------------
+void BaseApplication::locateConfiguration(void)
 {
 #ifdef _DEBUG
   resources_cfg = "resources_d.cfg";
@@ -209,6 +233,11 @@ void BaseApplication::go(void)
   resources_cfg = "resources.cfg";
   plugins_cfg = "plugins.cfg";
 #endif
+}
+//------------------------------------------------------------------------------
+void BaseApplication::go(void)
+{
+  locateConfiguration();
 
   // Check for errors
   if (!setup())
@@ -258,6 +287,9 @@ bool BaseApplication::frameRenderingQueued(const Ogre::FrameEvent& evt)
   if(mShutDown)
     return false;
 
+  // The camera has moved since the cursor was last looked at
+  frame_input_stale = true;
+
   //Need to capture/update each device
   keyboard->capture();
   mouse->capture();
@@ -267,7 +299,7 @@ bool BaseApplication::frameRenderingQueued(const Ogre::FrameEvent& evt)
   if (!tray->isDialogVisible())
   {
     // if dialog isn't up, then update the camera
-    camera_man->frameRenderingQueued(evt);
+    camera_man->frameRenderingQueued(evt, getFrameInput().ray);
     // if details panel is visible, then update its contents
     if (panel->isVisible())
     {
@@ -409,6 +441,9 @@ bool BaseApplication::keyReleased( const OIS::KeyEvent &evt )
 
 bool BaseApplication::mouseMoved( const OIS::MouseEvent &evt )
 {
+  // the cursor will need looking at again
+  frame_input_stale = true;
+
   // the tray may consume the event before it gets to the camera
   if (tray->injectMouseMove(evt))
     return true;
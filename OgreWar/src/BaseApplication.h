@@ -33,6 +33,7 @@ This source file is part of the
 
 #include <SdkTrays.h>
 #include <SdkCameraMan.h>
+#include "InputSnapshot.hpp"
 #include "OverheadCamera.hpp"
 
 class BaseApplication :
@@ -63,6 +64,9 @@ protected:
   OIS::InputManager* input;
   OIS::Mouse* mouse;
   OIS::Keyboard* keyboard;
+  // Cursor queries, shared by everything that needs them this frame
+  InputSnapshot frame_input;
+  bool frame_input_stale;
 
 
   /// METHODS
@@ -73,6 +77,7 @@ public:
 
   /// SUBROUTINES
 protected:
+  virtual void locateConfiguration(void);
   virtual bool setup();
   virtual bool configure(void);
   virtual void chooseSceneManager(void);
@@ -84,6 +89,8 @@ protected:
   virtual void setupResources(void);
   virtual void createResourceListener(void);
   virtual void loadResources(void);
+  const InputSnapshot& getFrameInput();
+  virtual void updateFrameInput(InputSnapshot& snapshot);
 
   // Ogre::FrameListener
   virtual bool frameRenderingQueued(const Ogre::FrameEvent& evt);
@@ -0,0 +1,539 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Benchmark.hpp"
+
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "HeightField.hpp"
+#include "JobSystem.hpp"
+#include "LineOfSight.hpp"
+#include "Formation.hpp"
+#include "MovementKernel.hpp"
+#include "SoldierStore.hpp"
+
+using namespace Ogre;
+using namespace std;
+
+/// METHODS
+
+bool Benchmark::run(const String& name, unsigned int n_soldiers,
+                    unsigned int n_ticks)
+{
+  if(name == "movement")
+    movement(n_soldiers, n_ticks);
+  else if(name == "picking")
+    picking(n_soldiers, n_ticks);
+  else if(name == "separation")
+    separation(n_soldiers, n_ticks);
+  else if(name == "clustered")
+    clustered(n_soldiers, n_ticks);
+  else if(name == "combat")
+    combat(n_soldiers, n_ticks);
+  else if(name == "sight")
+    sight(n_soldiers, n_ticks);
+  else if(name == "regiments")
+    regiments(n_soldiers, n_ticks);
+  else if(name == "raycast")
+    raycast(n_soldiers, n_ticks);
+  else
+    return false;
+  return true;
+}
+
+void Benchmark::printUsage()
+{
+  cerr << "Usage: OgreWar --benchmark <name> [soldiers] [ticks]" << endl
+       << "  where <name> is one of movement, picking, separation, clustered,"
+       << endl
+       << "  combat, sight, regiments or raycast" << endl;
+}
+
+void Benchmark::movement(unsigned int n_soldiers, unsigned int n_ticks)
+{
+  cout << "Movement kernel: " << n_soldiers << " soldiers, " << n_ticks
+       << " ticks" << endl;
+
+  double scalar_time = 0.0;
+  MovementKernel::InstructionSet best = MovementKernel::getBestInstructionSet();
+  for(int isa = MovementKernel::SCALAR; isa <= best; isa++)
+  {
+    // Same walkers every time: all heading off in random directions
+    srand(1);
+    vector<Real> pos_x(n_soldiers), pos_z(n_soldiers),
+                 dir_x(n_soldiers), dir_z(n_soldiers),
+                 dest_x(n_soldiers), dest_z(n_soldiers),
+                 distance_left(n_soldiers);
+    vector<unsigned int> arrived(n_soldiers);
+    for(unsigned int i = 0; i < n_soldiers; i++)
+    {
+      Real angle = Math::RangeRandom(0.0f, Math::TWO_PI);
+      dir_x[i] = Math::Cos(angle);
+      dir_z[i] = Math::Sin(angle);
+      distance_left[i] = Math::RangeRandom(0.0f, 1000.0f);
+      dest_x[i] = pos_x[i] + dir_x[i] * distance_left[i];
+      dest_z[i] = pos_z[i] + dir_z[i] * distance_left[i];
+    }
+
+    // Time the kernel, sending arrivals back the way they came
+    size_t n_arrived = 0;
+    Ogre::Timer timer;
+    for(unsigned int tick = 0; tick < n_ticks; tick++)
+    {
+      size_t n = MovementKernel::advance(n_soldiers, 0.5f,
+                        &pos_x[0], &pos_z[0], &dir_x[0], &dir_z[0],
+                        &dest_x[0], &dest_z[0], &distance_left[0],
+                        &arrived[0], (MovementKernel::InstructionSet)isa);
+      for(size_t a = 0; a < n; a++)
+      {
+        unsigned int i = arrived[a];
+        dir_x[i] = -dir_x[i];
+        dir_z[i] = -dir_z[i];
+        distance_left[i] = 1000.0f;
+        dest_x[i] = pos_x[i] + dir_x[i] * distance_left[i];
+        dest_z[i] = pos_z[i] + dir_z[i] * distance_left[i];
+      }
+      n_arrived += n;
+    }
+    double seconds = timer.getMicroseconds() / 1000000.0;
+    if(isa == MovementKernel::SCALAR)
+      scalar_time = seconds;
+
+    cout << "  " << MovementKernel::getName((MovementKernel::InstructionSet)isa)
+         << ": " << seconds << "s, "
+         << (seconds > 0 ? n_soldiers * double(n_ticks) / seconds : 0)
+         << " soldier-ticks/s, " << n_arrived << " arrivals";
+    if(isa != MovementKernel::SCALAR && seconds > 0)
+      cout << ", " << scalar_time / seconds << "x scalar";
+    cout << endl;
+  }
+}
+
+void Benchmark::picking(unsigned int n_soldiers, unsigned int n_picks)
+{
+  cout << "Picking: " << n_soldiers << " soldiers, " << n_picks << " picks"
+       << endl;
+
+  // Scatter headless Soldiers over a terrain page's worth of flat ground
+  srand(1);
+  const Real spread = 6000.0f;
+  SoldierStore soldiers;
+  for(unsigned int i = 0; i < n_soldiers; i++)
+    soldiers.create(Vector3(Math::RangeRandom(-spread, spread), 0.0f,
+                            Math::RangeRandom(-spread, spread)));
+
+  // One tick sorts everybody into the grid
+  HeightField flat;
+  JobSystem jobs;
+  soldiers.tick(0.0f, flat, jobs);
+
+  // Look down at random points from a camera-like height and angle
+  size_t n_hits = 0;
+  Ogre::Timer timer;
+  for(unsigned int p = 0; p < n_picks; p++)
+  {
+    Vector3 target(Math::RangeRandom(-spread, spread), 0.0f,
+                   Math::RangeRandom(-spread, spread));
+    Vector3 eye = target + Vector3(0.0f, 1000.0f, 1000.0f);
+    if(soldiers.pick(Ray(eye, (target - eye).normalisedCopy()))
+        != SoldierStore::NONE)
+      n_hits++;
+  }
+  double seconds = timer.getMicroseconds() / 1000000.0;
+
+  cout << "  " << (n_picks ? seconds * 1000000.0 / n_picks : 0)
+       << "us per pick, " << n_hits << " hits" << endl;
+}
+
+void Benchmark::separation(unsigned int max_soldiers, unsigned int n_ticks)
+{
+  cout << "Separation: up to " << max_soldiers << " soldiers, " << n_ticks
+       << " ticks" << endl;
+
+  static const unsigned int SIZES[] = { 1000, 2000, 5000, 10000, 20000, 50000 };
+  static const Real SPACING = 5.0f;
+  HeightField flat;
+  JobSystem jobs;
+  for(size_t s = 0; s < sizeof(SIZES) / sizeof(SIZES[0]); s++)
+  {
+    unsigned int n_soldiers = SIZES[s];
+    if(n_soldiers > max_soldiers)
+      break;
+
+    // Same crowding at every size: the area grows with the number of Soldiers
+    srand(1);
+    Real spread = Math::Sqrt(Real(n_soldiers)) * SPACING * 0.5f;
+    SoldierStore soldiers;
+    for(unsigned int i = 0; i < n_soldiers; i++)
+      soldiers.create(Vector3(Math::RangeRandom(-spread, spread), 0.0f,
+                              Math::RangeRandom(-spread, spread)));
+
+    // Time whole ticks: movement, separation and the grid rebuild
+    Ogre::Timer timer;
+    for(unsigned int tick = 0; tick < n_ticks; tick++)
+      soldiers.tick(1.0f / 30.0f, flat, jobs);
+    double seconds = timer.getMicroseconds() / 1000000.0;
+
+    cout << "  " << n_soldiers << ": "
+         << (n_ticks ? seconds * 1000000.0 / n_ticks : 0) << "us per tick, "
+         << (n_ticks ? seconds * 1e9 / (double(n_ticks) * n_soldiers) : 0)
+         << "ns per soldier" << endl;
+  }
+}
+
+void Benchmark::clustered(unsigned int n_soldiers, unsigned int n_ticks)
+{
+  cout << "Clustered: " << n_soldiers << " soldiers, " << n_ticks << " ticks"
+       << endl;
+
+  // Two crowds, each as tightly packed as in the separation benchmark, with
+  // more and more empty ground diagonally between them
+  static const Real GAPS[] = { 2000.0f, 20000.0f, 60000.0f };
+  static const Real SPACING = 5.0f;
+  HeightField flat;
+  JobSystem jobs;
+  for(size_t g = 0; g < sizeof(GAPS) / sizeof(GAPS[0]); g++)
+  {
+    srand(1);
+    Real spread = Math::Sqrt(Real(n_soldiers / 2)) * SPACING * 0.5f;
+    SoldierStore soldiers;
+    for(unsigned int i = 0; i < n_soldiers; i++)
+    {
+      Real centre = (i % 2) ? GAPS[g] * 0.5f : -GAPS[g] * 0.5f;
+      soldiers.create(Vector3(centre + Math::RangeRandom(-spread, spread), 0.0f,
+                              centre + Math::RangeRandom(-spread, spread)));
+    }
+
+    // Time whole ticks: movement, separation and the grid rebuild
+    Ogre::Timer timer;
+    for(unsigned int tick = 0; tick < n_ticks; tick++)
+      soldiers.tick(1.0f / 30.0f, flat, jobs);
+    double seconds = timer.getMicroseconds() / 1000000.0;
+
+    cout << "  " << GAPS[g] << " apart: "
+         << (n_ticks ? seconds * 1000000.0 / n_ticks : 0) << "us per tick"
+         << endl;
+  }
+}
+
+void Benchmark::combat(unsigned int n_soldiers, unsigned int n_ticks)
+{
+  cout << "Combat: " << n_soldiers << " soldiers, " << n_ticks << " ticks"
+       << endl;
+
+  // Two armies in square formations, just close enough to see each other
+  HeightField flat;
+  JobSystem jobs;
+  SoldierStore soldiers;
+  Formation square(Formation::SQUARE);
+  Real gap = 60.0f + Math::Sqrt(Real(n_soldiers)) * 5.0f;
+  soldiers.spawnRegiment(n_soldiers / 2, Vector3(0.0f, 0.0f, -gap * 0.5f),
+                         square, flat, 0);
+  soldiers.spawnRegiment(n_soldiers - n_soldiers / 2,
+                         Vector3(0.0f, 0.0f, gap * 0.5f), square, flat, 1);
+
+  // Time whole ticks, watching the worst one as the lines meet
+  double worst = 0.0;
+  Ogre::Timer timer;
+  for(unsigned int tick = 0; tick < n_ticks; tick++)
+  {
+    unsigned long start = timer.getMicroseconds();
+    soldiers.tick(1.0f / 30.0f, flat, jobs);
+    worst = std::max(worst, double(timer.getMicroseconds() - start));
+  }
+  double seconds = timer.getMicroseconds() / 1000000.0;
+
+  cout << "  " << (n_ticks ? seconds * 1000000.0 / n_ticks : 0)
+       << "us per tick, " << worst << "us worst, "
+       << n_soldiers - soldiers.size() << " fallen" << endl;
+}
+
+void Benchmark::sight(unsigned int n_soldiers, unsigned int n_ticks)
+{
+  cout << "Line of sight: " << n_soldiers << " soldiers, " << n_ticks
+       << " ticks" << endl;
+
+  // Rolling hills, about a terrain page in size
+  static const size_t SIZE = 513;
+  static const Real WORLD_SIZE = 12000.0f;
+  vector<float> heights(SIZE * SIZE);
+  for(size_t row = 0; row < SIZE; row++)
+    for(size_t col = 0; col < SIZE; col++)
+      heights[row * SIZE + col] = 200.0f * Math::Sin(col * 0.05f)
+                                         * Math::Cos(row * 0.04f);
+  HeightField hills;
+  hills.define(SIZE, WORLD_SIZE, Vector3::ZERO, &heights[0]);
+
+  // Everybody keeps an eye on somebody else, standing still
+  srand(1);
+  Real spread = WORLD_SIZE * 0.25f;
+  vector<Real> x(n_soldiers), z(n_soldiers),
+               other_x(n_soldiers), other_z(n_soldiers);
+  for(unsigned int i = 0; i < n_soldiers; i++)
+  {
+    x[i] = Math::RangeRandom(-spread, spread);
+    z[i] = Math::RangeRandom(-spread, spread);
+  }
+  for(unsigned int i = 0; i < n_soldiers; i++)
+  {
+    unsigned int other = rand() % n_soldiers;
+    other_x[i] = x[other];
+    other_z[i] = z[other];
+  }
+
+  // Several misses in one batch, one asked twice, must all be answered
+  JobSystem jobs;
+  LineOfSight sight;
+  static const size_t N_CHECKS = 5;
+  const Real check_x[N_CHECKS] = { -3000.0f, -1000.0f, 1000.0f, 3000.0f,
+                                   1000.0f },
+             check_z[N_CHECKS] = { 0.0f, 500.0f, -500.0f, 2000.0f, -500.0f },
+             target_x[N_CHECKS] = { 4000.0f, 2500.0f, -2000.0f, -3500.0f,
+                                    -2000.0f },
+             target_z[N_CHECKS] = { 1000.0f, -3000.0f, 2500.0f, -1500.0f,
+                                    2500.0f };
+  unsigned char checked[N_CHECKS];
+  memset(checked, 0xff, sizeof(checked));
+  sight.check(hills, jobs, N_CHECKS, check_x, check_z, target_x, target_z,
+              checked);
+  size_t n_wrong = 0;
+  for(size_t i = 0; i < N_CHECKS; i++)
+  {
+    Vector3 eye(check_x[i], 0.0f, check_z[i]),
+            target(target_x[i], 0.0f, target_z[i]);
+    eye.y = hills.getHeightAtWorldPosition(eye) + LineOfSight::EYE_HEIGHT;
+    target.y = hills.getHeightAtWorldPosition(target) + LineOfSight::EYE_HEIGHT;
+    n_wrong += (checked[i] != (unsigned char)hills.isLineClear(eye, target));
+  }
+  cout << "  " << n_wrong << " of " << N_CHECKS
+       << " fresh queries answered wrongly" << endl;
+  sight.clear();
+
+  // The first tick traces everything, later ones should hit the cache
+  vector<unsigned char> visible(n_soldiers);
+  double first = 0.0;
+  Ogre::Timer timer;
+  for(unsigned int tick = 0; tick < n_ticks; tick++)
+  {
+    sight.check(hills, jobs, n_soldiers, &x[0], &z[0], &other_x[0],
+                &other_z[0], &visible[0]);
+    if(tick == 0)
+      first = timer.getMicroseconds();
+  }
+  double seconds = timer.getMicroseconds() / 1000000.0;
+  size_t n_visible = 0;
+  for(unsigned int i = 0; i < n_soldiers; i++)
+    n_visible += visible[i];
+
+  cout << "  " << first << "us first tick, "
+       << (n_ticks > 1 ? (seconds * 1000000.0 - first) / (n_ticks - 1) : 0)
+       << "us per tick after, " << sight.getTraceCount() << " traces for "
+       << sight.getQueryCount() << " queries, " << n_visible << " visible"
+       << endl;
+}
+
+void Benchmark::regiments(unsigned int n_soldiers, unsigned int n_ticks)
+{
+  cout << "Regiments: " << n_soldiers << " soldiers, " << n_ticks << " ticks"
+       << endl;
+
+  // An army of idle regiments, with one of them fighting off an enemy
+  static const unsigned int REGIMENT_SIZE = 400;
+  static const Real SPACING = 500.0f;
+  HeightField flat;
+  JobSystem jobs;
+  SoldierStore soldiers;
+  Formation square(Formation::SQUARE);
+  unsigned int n_regiments = std::max(1u, n_soldiers / REGIMENT_SIZE);
+  unsigned int side = (unsigned int)Math::Ceil(Math::Sqrt(Real(n_regiments)));
+  for(unsigned int r = 0; r < n_regiments; r++)
+    soldiers.spawnRegiment(REGIMENT_SIZE, Vector3((r % side) * SPACING, 0.0f,
+                                                  (r / side) * SPACING),
+                           square, flat);
+  soldiers.spawnRegiment(REGIMENT_SIZE, Vector3(0.0f, 0.0f, -200.0f), square,
+                         flat, 1);
+
+  // Let the idle ones settle down before timing
+  for(unsigned int tick = 0; tick < 10; tick++)
+    soldiers.tick(1.0f / 30.0f, flat, jobs);
+  Ogre::Timer timer;
+  for(unsigned int tick = 0; tick < n_ticks; tick++)
+    soldiers.tick(1.0f / 30.0f, flat, jobs);
+  double seconds = timer.getMicroseconds() / 1000000.0;
+
+  cout << "  " << (n_ticks ? seconds * 1000000.0 / n_ticks : 0)
+       << "us per tick, " << soldiers.getActiveCount() << " of "
+       << soldiers.size() << " awake" << endl;
+}
+
+void Benchmark::raycast(unsigned int n_rays, unsigned int n_checks)
+{
+  cout << "Raycast: " << n_rays << " rays, " << n_checks << " checked" << endl;
+
+  // Four small pages of bumpy ground cut from one lattice, so that rays cross
+  // from page to page. Small enough to test every cell for every ray.
+  static const size_t SIZE = 65, SPAN = SIZE - 1, WIDE = 2 * SPAN + 1;
+  static const Real WORLD_SIZE = 640.0f;
+  vector<float> heights(WIDE * WIDE);
+  for(size_t row = 0; row < WIDE; row++)
+    for(size_t col = 0; col < WIDE; col++)
+      heights[row * WIDE + col] = 30.0f * Math::Sin(col * 0.15f)
+                                + 20.0f * Math::Cos(row * 0.17f)
+                                + 10.0f * Math::Sin((col + row) * 0.43f);
+  HeightField bumps;
+  vector<float> page(SIZE * SIZE);
+  for(size_t y = 0; y < 2; y++)
+    for(size_t x = 0; x < 2; x++)
+    {
+      for(size_t row = 0; row < SIZE; row++)
+        for(size_t col = 0; col < SIZE; col++)
+          page[row * SIZE + col] = heights[(y * SPAN + row) * WIDE
+                                           + x * SPAN + col];
+      bumps.addPage(SIZE, WORLD_SIZE, Vector3((x - 0.5f) * WORLD_SIZE, 0.0f,
+                                              (0.5f - y) * WORLD_SIZE),
+                    &page[0]);
+    }
+
+  // Compare rays and sight lines against every triangle of every cell
+  srand(1);
+  size_t n_hits = 0, n_ray_errors = 0, n_line_errors = 0;
+  for(unsigned int i = 0; i < n_checks; i++)
+  {
+    Vector3 eye(Math::RangeRandom(-WORLD_SIZE, WORLD_SIZE),
+                Math::RangeRandom(60.0f, 160.0f),
+                Math::RangeRandom(-WORLD_SIZE, WORLD_SIZE));
+    Vector3 direction(Math::RangeRandom(-0.5f, 0.5f),
+                      Math::RangeRandom(-0.6f, 0.0f),
+                      Math::RangeRandom(-0.5f, 0.5f));
+    if(i % 10 == 0)
+      direction = Vector3::NEGATIVE_UNIT_Y;
+    direction.normalise();
+    Ray ray(eye, direction);
+    Real t;
+    bool expected = castEveryCell(heights, WIDE, 2 * WORLD_SIZE, Vector3::ZERO,
+                                  ray, Math::POS_INFINITY, t);
+    Vector3 hit;
+    bool found = bumps.getRayCollision(ray, &hit);
+    n_hits += expected;
+    if(found != expected
+    || (expected && hit.distance(ray.getPoint(t)) > 0.01f))
+      n_ray_errors++;
+
+    Vector3 a(Math::RangeRandom(-WORLD_SIZE, WORLD_SIZE), 0.0f,
+              Math::RangeRandom(-WORLD_SIZE, WORLD_SIZE)),
+            b(Math::RangeRandom(-WORLD_SIZE, WORLD_SIZE), 0.0f,
+              Math::RangeRandom(-WORLD_SIZE, WORLD_SIZE));
+    a.y = bumps.getHeightAtWorldPosition(a) + 8.0f;
+    b.y = bumps.getHeightAtWorldPosition(b) + 8.0f;
+    bool blocked = castEveryCell(heights, WIDE, 2 * WORLD_SIZE, Vector3::ZERO,
+                                 Ray(a, b - a), 1.0f, t);
+    if(bumps.isLineClear(a, b) == blocked)
+      n_line_errors++;
+  }
+  cout << "  " << n_hits << " hits, " << n_ray_errors << " rays and "
+       << n_line_errors << " sight lines disagree with testing every cell"
+       << endl;
+
+  // Time camera-like rays over a full-sized page of rolling hills
+  static const size_t BIG_SIZE = 513;
+  static const Real BIG_WORLD_SIZE = 12000.0f;
+  vector<float> hills(BIG_SIZE * BIG_SIZE);
+  for(size_t row = 0; row < BIG_SIZE; row++)
+    for(size_t col = 0; col < BIG_SIZE; col++)
+      hills[row * BIG_SIZE + col] = 300.0f + 250.0f * Math::Sin(col * 0.03f)
+                                                    * Math::Cos(row * 0.021f);
+  HeightField terrain;
+  terrain.define(BIG_SIZE, BIG_WORLD_SIZE, Vector3::ZERO, &hills[0]);
+  n_hits = 0;
+  Ogre::Timer timer;
+  for(unsigned int i = 0; i < n_rays; i++)
+  {
+    Real half = BIG_WORLD_SIZE * 0.5f;
+    Vector3 eye(Math::RangeRandom(-half, half), 1500.0f,
+                Math::RangeRandom(-half, half));
+    Vector3 direction(Math::RangeRandom(-0.5f, 0.5f),
+                      Math::RangeRandom(-0.45f, -0.15f),
+                      Math::RangeRandom(-0.5f, 0.5f));
+    direction.normalise();
+    n_hits += terrain.getRayCollision(Ray(eye, direction));
+  }
+  double seconds = timer.getMicroseconds() / 1000000.0;
+
+  cout << "  " << (n_rays ? seconds * 1000000.0 / n_rays : 0)
+       << "us per ray, " << n_hits << " hits" << endl;
+}
+
+/// SUBROUTINES
+
+bool Benchmark::castEveryCell(const vector<float>& heights, size_t size,
+                              Real world_size, const Vector3& origin,
+                              const Ray& ray, Real max_t, Real& t)
+{
+  // Terrain rows run from south to north, and each cell is split into two
+  // triangles along a diagonal that alternates from row to row
+  Real spacing = world_size / (size - 1),
+       half = 0.5f * world_size;
+  const Vector3& o = ray.getOrigin();
+  const Vector3& d = ray.getDirection();
+  bool hit = false;
+  for(size_t row = 0; row + 1 < size; row++)
+    for(size_t col = 0; col + 1 < size; col++)
+    {
+      Vector3 corner[2][2];
+      for(size_t j = 0; j < 2; j++)
+        for(size_t i = 0; i < 2; i++)
+          corner[j][i] = origin + Vector3((col + i) * spacing - half,
+                                          heights[(row + j) * size + col + i],
+                                          half - (row + j) * spacing);
+      const Vector3* triangles[2][3] =
+      {
+        { &corner[0][0], &corner[0][1], (row % 2 == 0) ? &corner[1][1]
+                                                       : &corner[1][0] },
+        { (row % 2 == 0) ? &corner[0][0] : &corner[0][1], &corner[1][1],
+          &corner[1][0] }
+      };
+
+      // Moller-Trumbore, in doubles so as not to share the same rounding
+      for(int k = 0; k < 2; k++)
+      {
+        const Vector3& a = *triangles[k][0];
+        Vector3 e1 = *triangles[k][1] - a, e2 = *triangles[k][2] - a;
+        Vector3 p = d.crossProduct(e2);
+        double det = e1.dotProduct(p);
+        if(Math::Abs(det) < 1e-12)
+          continue;
+        Vector3 s = o - a;
+        double u = s.dotProduct(p) / det;
+        if(u < 0.0 || u > 1.0)
+          continue;
+        Vector3 q = s.crossProduct(e1);
+        double v = d.dotProduct(q) / det;
+        if(v < 0.0 || u + v > 1.0)
+          continue;
+        double t_hit = e2.dotProduct(q) / det;
+        if(t_hit >= 0.0 && t_hit <= max_t && (!hit || t_hit < t))
+        {
+          t = t_hit;
+          hit = true;
+        }
+      }
+    }
+  return hit;
+}
@@ -0,0 +1,52 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENCHMARK_HPP_INCLUDED
+#define BENCHMARK_HPP_INCLUDED
+
+#include <vector>
+
+#include <Ogre.h>
+
+class Benchmark
+{
+  /// METHODS
+public:
+  // run a benchmark by name, returning false if there is no such benchmark
+  static bool run(const Ogre::String& name, unsigned int n_soldiers,
+                  unsigned int n_ticks);
+  static void printUsage();
+  // individual benchmarks
+  static void movement(unsigned int n_soldiers, unsigned int n_ticks);
+  static void picking(unsigned int n_soldiers, unsigned int n_picks);
+  static void separation(unsigned int max_soldiers, unsigned int n_ticks);
+  static void clustered(unsigned int n_soldiers, unsigned int n_ticks);
+  static void combat(unsigned int n_soldiers, unsigned int n_ticks);
+  static void sight(unsigned int n_soldiers, unsigned int n_ticks);
+  static void regiments(unsigned int n_soldiers, unsigned int n_ticks);
+  static void raycast(unsigned int n_rays, unsigned int n_checks);
+
+  /// SUBROUTINES
+private:
+  static bool castEveryCell(const std::vector<float>& heights, size_t size,
+                            Ogre::Real world_size, const Ogre::Vector3& origin,
+                            const Ogre::Ray& ray, Ogre::Real max_t,
+                            Ogre::Real& t);
+};
+
+#endif // BENCHMARK_HPP_INCLUDED
@@ -0,0 +1,168 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "BlendPainter.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef BLENDPAINTER_SSE
+  #include <xmmintrin.h>
+#endif
+
+using namespace Ogre;
+using namespace std;
+
+/// CREATION, DESTRUCTION
+
+BlendPainter::BlendPainter() :
+rules(NULL),
+n_rules(0),
+heights(NULL),
+terrain_size(0),
+spacing(1.0f),
+blend(),
+blend_size(0),
+columns(),
+weights()
+{
+}
+
+BlendPainter::~BlendPainter()
+{
+}
+
+void BlendPainter::setup(Terrain* terrain, const Rule* _rules, size_t _n_rules)
+{
+  // Terrain creates blend maps on demand, so fetch them here on the main
+  // thread: the workers only ever see plain arrays
+  rules = _rules;
+  n_rules = _n_rules;
+  heights = terrain->getHeightData();
+  terrain_size = terrain->getSize();
+  spacing = terrain->getWorldSize() / (terrain_size - 1);
+  blend.resize(n_rules);
+  for(size_t r = 0; r < n_rules; r++)
+    blend[r] = terrain->getLayerBlendMap((uint8)(r + 1))->getBlendPointer();
+  blend_size = terrain->getLayerBlendMapSize();
+
+  // Every row maps texels to samples the same way, so work it out once
+  Real to_sample = (Real)(terrain_size - 1) / (blend_size - 1);
+  columns.resize(blend_size);
+  weights.resize(blend_size);
+  for(size_t x = 0; x < blend_size; x++)
+  {
+    Real fx = x * to_sample;
+    columns[x] = std::min((size_t)fx, terrain_size - 2);
+    weights[x] = fx - columns[x];
+  }
+}
+
+/// QUERY
+
+size_t BlendPainter::getRowCount() const
+{
+  return blend_size;
+}
+
+/// UPDATE
+
+void BlendPainter::run(size_t begin, size_t end)
+{
+  // Scratch rows are local, as each worker paints its own band
+  vector<float> row(terrain_size), rise(terrain_size),
+                height(blend_size), slope(blend_size);
+  const Real to_sample = (Real)(terrain_size - 1) / (blend_size - 1),
+             inv_spacing = 1.0f / spacing;
+
+  for(size_t y = begin; y < end; y++)
+  {
+    // Blend map rows run down the page, terrain rows up it
+    Real fy = (blend_size - 1 - y) * to_sample;
+    size_t y0 = std::min((size_t)fy, terrain_size - 2);
+    Real v = fy - y0;
+    const float* h0 = heights + y0 * terrain_size;
+    const float* h1 = h0 + terrain_size;
+
+    // Blend the two sample rows around this texel row
+    for(size_t c = 0; c < terrain_size; c++)
+    {
+      rise[c] = h1[c] - h0[c];
+      row[c] = h0[c] + rise[c] * v;
+    }
+
+    // Then along the row, finding the height and steepness under each texel
+    for(size_t x = 0; x < blend_size; x++)
+    {
+      size_t c = columns[x];
+      Real u = weights[x],
+           dx = row[c + 1] - row[c],
+           dy = rise[c] + (rise[c + 1] - rise[c]) * u;
+      height[x] = row[c] + dx * u;
+      slope[x] = std::sqrt(dx * dx + dy * dy) * inv_spacing;
+    }
+
+    // Then each layer in turn, over the whole row
+    for(size_t r = 0; r < n_rules; r++)
+      paintRow(rules[r], &height[0], &slope[0], blend[r] + y * blend_size,
+               blend_size);
+  }
+}
+
+/// SUBROUTINES
+
+void BlendPainter::paintRow(const Rule& rule, const float* height,
+                            const float* slope, float* out, size_t count)
+{
+  // A layer fades in from whichever edge of its ranges is nearest
+  const float min_height = rule.min_height, max_height = rule.max_height,
+              max_slope = rule.max_slope,
+              height_k = 1.0f / rule.height_fade,
+              slope_k = 1.0f / rule.slope_fade;
+  size_t x = 0;
+
+#ifdef BLENDPAINTER_SSE
+  // Four texels at a time, clamping with min and max rather than branches
+  const __m128 v_min_height = _mm_set1_ps(min_height),
+               v_max_height = _mm_set1_ps(max_height),
+               v_max_slope = _mm_set1_ps(max_slope),
+               v_height_k = _mm_set1_ps(height_k),
+               v_slope_k = _mm_set1_ps(slope_k),
+               v_zero = _mm_setzero_ps(),
+               v_one = _mm_set1_ps(1.0f);
+  for(; x + 4 <= count; x += 4)
+  {
+    __m128 h = _mm_loadu_ps(height + x),
+           above = _mm_mul_ps(_mm_sub_ps(h, v_min_height), v_height_k),
+           below = _mm_mul_ps(_mm_sub_ps(v_max_height, h), v_height_k),
+           flat = _mm_mul_ps(_mm_sub_ps(v_max_slope, _mm_loadu_ps(slope + x)),
+                             v_slope_k);
+    __m128 val = _mm_min_ps(_mm_min_ps(above, below), flat);
+    _mm_storeu_ps(out + x, _mm_max_ps(v_zero, _mm_min_ps(val, v_one)));
+  }
+#endif
+
+  // Whatever is left over, or everything without SSE
+  for(; x < count; x++)
+  {
+    float above = (height[x] - min_height) * height_k,
+          below = (max_height - height[x]) * height_k,
+          flat = (max_slope - slope[x]) * slope_k;
+    float val = std::min(std::min(above, below), flat);
+    out[x] = std::max(0.0f, std::min(val, 1.0f));
+  }
+}
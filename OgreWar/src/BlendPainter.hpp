@@ -0,0 +1,78 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef BLENDPAINTER_HPP_INCLUDED
+#define BLENDPAINTER_HPP_INCLUDED
+
+#include <vector>
+
+#include <Ogre.h>
+#include <OGRE/Terrain/OgreTerrain.h>
+
+#include "JobSystem.hpp"
+
+// SSE needs an x86 compiler that targets it
+#if defined(__SSE__) || defined(_M_X64) \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+  #define BLENDPAINTER_SSE
+#endif
+
+// Paints the blend maps of a terrain page from a table of rules, one band of
+// rows per task, reading the page's heights directly
+class BlendPainter : public JobSystem::Job
+{
+  /// NESTING
+public:
+  // Where a layer shows, fading in from the edges of its ranges. Slope is
+  // rise over run. The first rule paints layer 1, over the base layer 0.
+  struct Rule
+  {
+    Ogre::Real min_height, max_height, height_fade;
+    Ogre::Real max_slope, slope_fade;
+  };
+
+  /// ATTRIBUTES
+private:
+  const Rule* rules;
+  size_t n_rules;
+  const float* heights;         // Row-major samples, ascending terrain-space y
+  size_t terrain_size;          // Number of samples along each side
+  Ogre::Real spacing;           // World units between samples
+  std::vector<float*> blend;    // One blend map per rule, rows top-down
+  size_t blend_size;            // Number of texels along each side
+  // texel column -> sample column to its left, and how far to the right
+  std::vector<size_t> columns;
+  std::vector<float> weights;
+
+  /// METHODS
+public:
+  // creation, destruction
+  BlendPainter();
+  virtual ~BlendPainter();
+  void setup(Ogre::Terrain* terrain, const Rule* _rules, size_t _n_rules);
+  // query
+  size_t getRowCount() const;
+  // update
+  void run(size_t begin, size_t end);
+
+  /// SUBROUTINES
+private:
+  static void paintRow(const Rule& rule, const float* height,
+                       const float* slope, float* out, size_t count);
+};
+
+#endif // BLENDPAINTER_HPP_INCLUDED
@@ -0,0 +1,149 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "CostGrid.hpp"
+
+using namespace Ogre;
+using namespace std;
+
+/// CONSTANTS
+
+const Real CostGrid::IMPASSABLE = Math::POS_INFINITY;
+const Real CostGrid::SLOPE_COST = 8.0f;
+const Real CostGrid::MAX_SLOPE = 1.0f;
+
+/// CREATION, DESTRUCTION
+
+CostGrid::CostGrid() :
+n_cells(0),
+cell_size(0.0f),
+min_x(0.0f), min_z(0.0f),
+cost(),
+revision(0)
+{
+}
+
+CostGrid::~CostGrid()
+{
+}
+
+void CostGrid::build(const HeightField& terrain, int cells_per_page)
+{
+  revision = terrain.getRevision();
+  if(terrain.isEmpty() || cells_per_page < 2)
+  {
+    n_cells = 0;
+    cost.clear();
+    return;
+  }
+
+  // Snap the corner to multiples of the cell size, so that the same spot
+  // falls in the same cell however far the terrain reaches
+  cell_size = terrain.getPageWorldSize() / cells_per_page;
+  Real half = terrain.getWorldSize() * 0.5f;
+  const Vector3& centre = terrain.getOrigin();
+  min_x = Math::Floor((centre.x - half) / cell_size) * cell_size;
+  min_z = Math::Floor((centre.z - half) / cell_size) * cell_size;
+  n_cells = (int)Math::Ceil((max(centre.x - min_x, centre.z - min_z)
+                             + half) / cell_size);
+
+  // Sample the height at every cell centre in one batch
+  size_t n = n_cells * n_cells;
+  vector<Real> x(n), z(n), h(n);
+  for(int row = 0; row < n_cells; row++)
+    for(int col = 0; col < n_cells; col++)
+    {
+      x[row * n_cells + col] = min_x + (col + 0.5f) * cell_size;
+      z[row * n_cells + col] = min_z + (row + 0.5f) * cell_size;
+    }
+  terrain.sampleHeights(&x[0], &z[0], &h[0], n);
+
+  // The steepest climb to a neighbour decides how hard a cell is to cross
+  cost.resize(n);
+  for(int row = 0; row < n_cells; row++)
+    for(int col = 0; col < n_cells; col++)
+    {
+      size_t i = row * n_cells + col;
+      Real climb = 0.0f;
+      if(col > 0)
+        climb = max(climb, Math::Abs(h[i] - h[i - 1]));
+      if(col < n_cells - 1)
+        climb = max(climb, Math::Abs(h[i] - h[i + 1]));
+      if(row > 0)
+        climb = max(climb, Math::Abs(h[i] - h[i - n_cells]));
+      if(row < n_cells - 1)
+        climb = max(climb, Math::Abs(h[i] - h[i + n_cells]));
+      Real slope = climb / cell_size;
+      cost[i] = (slope > MAX_SLOPE) ? IMPASSABLE : 1.0f + slope * SLOPE_COST;
+    }
+}
+
+/// QUERY
+
+bool CostGrid::isEmpty() const
+{
+  return cost.empty();
+}
+
+unsigned int CostGrid::getRevision() const
+{
+  return revision;
+}
+
+int CostGrid::getSize() const
+{
+  return n_cells;
+}
+
+Real CostGrid::getCellSize() const
+{
+  return cell_size;
+}
+
+bool CostGrid::getCell(Real x, Real z, int& col, int& row) const
+{
+  if(cost.empty())
+    return false;
+  col = (int)Math::Floor((x - min_x) / cell_size);
+  row = (int)Math::Floor((z - min_z) / cell_size);
+  return (col >= 0 && col < n_cells && row >= 0 && row < n_cells);
+}
+
+Vector3 CostGrid::getCellCentre(int col, int row) const
+{
+  return Vector3(min_x + (col + 0.5f) * cell_size, 0.0f,
+                 min_z + (row + 0.5f) * cell_size);
+}
+
+Real CostGrid::getCost(int col, int row) const
+{
+  return cost[row * n_cells + col];
+}
+
+bool CostGrid::isPassable(int col, int row) const
+{
+  return (col >= 0 && col < n_cells && row >= 0 && row < n_cells
+          && cost[row * n_cells + col] != IMPASSABLE);
+}
+
+bool CostGrid::isPassableAt(Real x, Real z) const
+{
+  // Off the grid there is nothing to stop anybody
+  int col, row;
+  return !getCell(x, z, col, row) || isPassable(col, row);
+}
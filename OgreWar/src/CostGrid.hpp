@@ -0,0 +1,66 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COSTGRID_HPP_INCLUDED
+#define COSTGRID_HPP_INCLUDED
+
+#include <vector>
+
+#include <Ogre.h>
+
+#include "HeightField.hpp"
+
+// Coarse grid over the terrain giving the cost of walking through each cell,
+// derived from how steep the ground is there. Cells keep their size and place
+// in the world as pages come and go, though their indices shift.
+class CostGrid
+{
+  /// CONSTANTS
+public:
+  static const Ogre::Real IMPASSABLE;
+private:
+  static const Ogre::Real SLOPE_COST;
+  static const Ogre::Real MAX_SLOPE;
+
+  /// ATTRIBUTES
+private:
+  int n_cells;                    // Number of cells along each side
+  Ogre::Real cell_size;
+  Ogre::Real min_x, min_z;        // Corner of cell (0, 0)
+  std::vector<Ogre::Real> cost;   // Row-major, IMPASSABLE where too steep
+  unsigned int revision;          // Revision of the heights used
+
+  /// METHODS
+public:
+  // creation, destruction
+  CostGrid();
+  virtual ~CostGrid();
+  void build(const HeightField& terrain, int cells_per_page);
+  // query
+  bool isEmpty() const;
+  unsigned int getRevision() const;
+  int getSize() const;
+  Ogre::Real getCellSize() const;
+  bool getCell(Ogre::Real x, Ogre::Real z, int& col, int& row) const;
+  Ogre::Vector3 getCellCentre(int col, int row) const;
+  Ogre::Real getCost(int col, int row) const;
+  bool isPassable(int col, int row) const;
+  bool isPassableAt(Ogre::Real x, Ogre::Real z) const;
+};
+
+#endif // COSTGRID_HPP_INCLUDED
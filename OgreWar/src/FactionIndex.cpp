@@ -0,0 +1,113 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "FactionIndex.hpp"
+
+using namespace Ogre;
+using namespace std;
+
+/// CONSTANTS
+
+const unsigned int FactionIndex::NONE = (unsigned int)-1;
+
+/// CREATION, DESTRUCTION
+
+FactionIndex::Faction::Faction(Real cell_size) :
+grid(cell_size),
+x(), z(),
+members()
+{
+}
+
+FactionIndex::FactionIndex(Real _cell_size) :
+cell_size(_cell_size),
+factions()
+{
+}
+
+FactionIndex::~FactionIndex()
+{
+}
+
+void FactionIndex::build(const unsigned char* faction, const Real* x,
+                         const Real* z, size_t count)
+{
+  // Split everybody up by faction, keeping the allocations from last time
+  for(size_t f = 0; f < factions.size(); f++)
+  {
+    factions[f].x.clear();
+    factions[f].z.clear();
+    factions[f].members.clear();
+  }
+  for(size_t i = 0; i < count; i++)
+  {
+    while(faction[i] >= factions.size())
+      factions.push_back(Faction(cell_size));
+    Faction& f = factions[faction[i]];
+    f.x.push_back(x[i]);
+    f.z.push_back(z[i]);
+    f.members.push_back(i);
+  }
+
+  // Then sort each faction into its own grid
+  for(size_t f = 0; f < factions.size(); f++)
+  {
+    if(factions[f].members.empty())
+      factions[f].grid.clear();
+    else
+      factions[f].grid.build(&factions[f].x[0], &factions[f].z[0],
+                             factions[f].members.size());
+  }
+}
+
+/// QUERY
+
+unsigned int FactionIndex::findNearestEnemy(unsigned char faction, Real x,
+                                            Real z, Real range) const
+{
+  unsigned int nearest = NONE;
+  Real best = range * range;
+  for(size_t f = 0; f < factions.size(); f++)
+  {
+    const Faction& enemy = factions[f];
+    if(f == faction || enemy.grid.isEmpty())
+      continue;
+
+    // Only the cells within range of the point
+    int col0, row0, col1, row1;
+    enemy.grid.getCell(x - range, z - range, col0, row0);
+    enemy.grid.getCell(x + range, z + range, col1, row1);
+    for(int row = row0; row <= row1; row++)
+    for(int col = col0; col <= col1; )
+    {
+      const unsigned int *first, *last;
+      col = enemy.grid.getRowItems(row, col, col1, first, last);
+      for(const unsigned int* j = first; j != last; j++)
+      {
+        Real dx = enemy.x[*j] - x, dz = enemy.z[*j] - z;
+        Real distance_2 = dx * dx + dz * dz;
+        if(distance_2 < best)
+        {
+          best = distance_2;
+          nearest = enemy.members[*j];
+        }
+      }
+    }
+  }
+  return nearest;
+}
@@ -0,0 +1,64 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FACTIONINDEX_HPP_INCLUDED
+#define FACTIONINDEX_HPP_INCLUDED
+
+#include <deque>
+#include <vector>
+
+#include <Ogre.h>
+
+#include "SpatialGrid.hpp"
+
+// One SpatialGrid per faction, so that looking for enemies never has to
+// wade through friends
+class FactionIndex
+{
+  /// CONSTANTS
+public:
+  static const unsigned int NONE;
+
+  /// NESTING
+private:
+  struct Faction
+  {
+    SpatialGrid grid;
+    std::vector<Ogre::Real> x, z;
+    std::vector<unsigned int> members;  // Grid item -> index given to build
+    Faction(Ogre::Real cell_size);
+  };
+
+  /// ATTRIBUTES
+private:
+  Ogre::Real cell_size;
+  std::deque<Faction> factions;
+
+  /// METHODS
+public:
+  // creation, destruction
+  FactionIndex(Ogre::Real _cell_size);
+  virtual ~FactionIndex();
+  void build(const unsigned char* faction, const Ogre::Real* x,
+             const Ogre::Real* z, size_t count);
+  // query
+  unsigned int findNearestEnemy(unsigned char faction, Ogre::Real x,
+                                Ogre::Real z, Ogre::Real range) const;
+};
+
+#endif // FACTIONINDEX_HPP_INCLUDED
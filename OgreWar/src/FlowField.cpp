@@ -0,0 +1,160 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "FlowField.hpp"
+
+#include <functional>
+#include <queue>
+
+using namespace Ogre;
+using namespace std;
+
+/// UTILITY
+
+// Cells outside of the corridor are treated as if they were impassable
+static bool isOpen(const CostGrid& grid, const vector<unsigned char>* corridor,
+                   int col, int row)
+{
+  return grid.isPassable(col, row)
+      && (!corridor || (*corridor)[row * grid.getSize() + col]);
+}
+
+/// CREATION, DESTRUCTION
+
+FlowField::FlowField() :
+n_cells(0),
+goal_col(0), goal_row(0),
+integration(),
+flow_x(), flow_z()
+{
+}
+
+FlowField::~FlowField()
+{
+}
+
+void FlowField::compute(const CostGrid& grid, int _goal_col, int _goal_row,
+                        const vector<unsigned char>* corridor)
+{
+  static const int STEP_COL[8] = { 1, -1, 0, 0, 1, 1, -1, -1 },
+                   STEP_ROW[8] = { 0, 0, 1, -1, 1, -1, 1, -1 };
+  static const float STEP_LENGTH[8] = { 1.0f, 1.0f, 1.0f, 1.0f,
+                              1.41421356f, 1.41421356f, 1.41421356f, 1.41421356f };
+
+  n_cells = grid.getSize();
+  goal_col = _goal_col;
+  goal_row = _goal_row;
+  size_t n = n_cells * n_cells;
+  integration.assign(n, Math::POS_INFINITY);
+  flow_x.assign(n, 0.0f);
+  flow_z.assign(n, 0.0f);
+  if(!isOpen(grid, corridor, goal_col, goal_row))
+    return;
+
+  // Integrate the cost of reaching the goal outwards from it (Dijkstra)
+  typedef pair<float, int> Entry;
+  priority_queue<Entry, vector<Entry>, greater<Entry> > open;
+  integration[goal_row * n_cells + goal_col] = 0.0f;
+  open.push(Entry(0.0f, goal_row * n_cells + goal_col));
+  while(!open.empty())
+  {
+    Entry entry = open.top();
+    open.pop();
+    int cell = entry.second;
+    if(entry.first > integration[cell])
+      continue;
+    int col = cell % n_cells, row = cell / n_cells;
+    float here = grid.getCost(col, row);
+    for(int s = 0; s < 8; s++)
+    {
+      int c = col + STEP_COL[s], r = row + STEP_ROW[s];
+      if(!isOpen(grid, corridor, c, r))
+        continue;
+      // Don't cut corners past impassable cells
+      if(s >= 4 && (!isOpen(grid, corridor, c, row)
+                    || !isOpen(grid, corridor, col, r)))
+        continue;
+      float total = entry.first
+                  + 0.5f * (here + grid.getCost(c, r)) * STEP_LENGTH[s];
+      int next = r * n_cells + c;
+      if(total < integration[next])
+      {
+        integration[next] = total;
+        open.push(Entry(total, next));
+      }
+    }
+  }
+
+  // Each cell points at its cheapest neighbour
+  for(int row = 0; row < n_cells; row++)
+    for(int col = 0; col < n_cells; col++)
+    {
+      int cell = row * n_cells + col;
+      float best = integration[cell];
+      int best_step = -1;
+      for(int s = 0; s < 8; s++)
+      {
+        int c = col + STEP_COL[s], r = row + STEP_ROW[s];
+        if(!isOpen(grid, corridor, c, r))
+          continue;
+        if(s >= 4 && (!isOpen(grid, corridor, c, row)
+                      || !isOpen(grid, corridor, col, r)))
+          continue;
+        if(integration[r * n_cells + c] < best)
+        {
+          best = integration[r * n_cells + c];
+          best_step = s;
+        }
+      }
+      if(best_step >= 0)
+      {
+        flow_x[cell] = STEP_COL[best_step] / STEP_LENGTH[best_step];
+        flow_z[cell] = STEP_ROW[best_step] / STEP_LENGTH[best_step];
+      }
+    }
+}
+
+/// QUERY
+
+int FlowField::getGoalColumn() const
+{
+  return goal_col;
+}
+
+int FlowField::getGoalRow() const
+{
+  return goal_row;
+}
+
+bool FlowField::getDirection(const CostGrid& grid, Real x, Real z,
+                             Real& dx, Real& dz) const
+{
+  // Nothing to follow outside the grid, in the goal cell or if cut off
+  int col, row;
+  if(!grid.getCell(x, z, col, row))
+    return false;
+  int cell = row * n_cells + col;
+  dx = flow_x[cell];
+  dz = flow_z[cell];
+  return (dx != 0.0f || dz != 0.0f);
+}
+
+Real FlowField::getPathCost(int col, int row) const
+{
+  return integration[row * n_cells + col];
+}
@@ -0,0 +1,54 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FLOWFIELD_HPP_INCLUDED
+#define FLOWFIELD_HPP_INCLUDED
+
+#include <vector>
+
+#include <Ogre.h>
+
+#include "CostGrid.hpp"
+
+// Direction to walk in from every cell of a CostGrid to reach one goal cell,
+// computed once and then shared by everyone heading there
+class FlowField
+{
+  /// ATTRIBUTES
+private:
+  int n_cells;
+  int goal_col, goal_row;
+  std::vector<float> integration;   // Cost of the cheapest path to the goal
+  std::vector<float> flow_x, flow_z; // Unit direction, zero if no way through
+
+  /// METHODS
+public:
+  // creation, destruction
+  FlowField();
+  virtual ~FlowField();
+  void compute(const CostGrid& grid, int _goal_col, int _goal_row,
+               const std::vector<unsigned char>* corridor = NULL);
+  // query
+  int getGoalColumn() const;
+  int getGoalRow() const;
+  bool getDirection(const CostGrid& grid, Ogre::Real x, Ogre::Real z,
+                    Ogre::Real& dx, Ogre::Real& dz) const;
+  Ogre::Real getPathCost(int col, int row) const;
+};
+
+#endif // FLOWFIELD_HPP_INCLUDED
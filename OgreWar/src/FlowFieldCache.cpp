@@ -0,0 +1,187 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "FlowFieldCache.hpp"
+
+using namespace Ogre;
+using namespace std;
+
+/// CONSTANTS
+
+const unsigned int FlowFieldCache::NONE = (unsigned int)-1;
+// cells are fixed in the world: fine enough to steer around hills, yet few
+// enough that every field stays small with the whole map resident
+const int FlowFieldCache::CELLS_PER_PAGE = 64;
+const size_t FlowFieldCache::CAPACITY = 16;
+
+/// CREATION, DESTRUCTION
+
+FlowFieldCache::Slot::Slot() :
+field(),
+goal(-1),
+origin(-1),
+from(Vector3::ZERO),
+to(Vector3::ZERO),
+refs(0),
+last_used(0)
+{
+}
+
+FlowFieldCache::FlowFieldCache() :
+grid(),
+routes(),
+corridor(),
+slots(),
+n_requests(0)
+{
+}
+
+FlowFieldCache::~FlowFieldCache()
+{
+}
+
+void FlowFieldCache::update(const HeightField& terrain)
+{
+  if(grid.getRevision() == terrain.getRevision() && !grid.isEmpty())
+    return;
+
+  // The ground changed: rebuild the costs, routes and every field in use.
+  // Cell and cluster numbers have moved, so find each destination afresh.
+  grid.build(terrain, CELLS_PER_PAGE);
+  routes.update(grid);
+  for(deque<Slot>::iterator i = slots.begin(); i != slots.end(); i++)
+  {
+    if(i->refs > 0)
+    {
+      locate(*i);
+      compute(*i);
+    }
+    else
+      i->goal = -1;
+  }
+}
+
+/// FIELDS
+
+unsigned int FlowFieldCache::acquire(const Vector3& destination,
+                                     const Vector3* origin)
+{
+  int col, row;
+  if(!grid.getCell(destination.x, destination.z, col, row))
+    return NONE;
+  int goal = row * grid.getSize() + col;
+  n_requests++;
+
+  // Orders from another cluster get a field of their own along their route
+  int start = origin ? routes.getCluster(*origin) : -1;
+  if(start == routes.getCluster(destination))
+    start = -1;
+
+  // Reuse the field if somebody already asked for this destination
+  unsigned int victim = NONE;
+  for(size_t i = 0; i < slots.size(); i++)
+  {
+    if(slots[i].goal == goal && slots[i].origin == start)
+    {
+      slots[i].last_used = n_requests;
+      return i;
+    }
+    // Otherwise remember the stalest field nobody is following
+    if(slots[i].refs <= 0 && (victim == NONE || slots[i].goal < 0
+        || (slots[victim].goal >= 0
+            && slots[i].last_used < slots[victim].last_used)))
+      victim = i;
+  }
+
+  // Grow past the capacity only if every field is in use
+  if(victim == NONE || (slots[victim].goal >= 0 && slots.size() < CAPACITY))
+  {
+    victim = slots.size();
+    slots.emplace_back();
+  }
+
+  // One integration pass for everybody given this destination
+  Slot& slot = slots[victim];
+  slot.goal = goal;
+  slot.origin = start;
+  slot.from = origin ? *origin : destination;
+  slot.to = destination;
+  slot.last_used = n_requests;
+  compute(slot);
+  return victim;
+}
+
+void FlowFieldCache::retain(unsigned int field)
+{
+  if(field != NONE)
+    slots[field].refs++;
+}
+
+void FlowFieldCache::release(unsigned int field)
+{
+  if(field != NONE)
+    slots[field].refs--;
+}
+
+/// QUERY
+
+const CostGrid& FlowFieldCache::getCostGrid() const
+{
+  return grid;
+}
+
+const PathCache& FlowFieldCache::getRoutes() const
+{
+  return routes;
+}
+
+const FlowField& FlowFieldCache::getField(unsigned int field) const
+{
+  return slots[field].field;
+}
+
+size_t FlowFieldCache::getFieldCount() const
+{
+  return slots.size();
+}
+
+/// SUBROUTINES
+
+void FlowFieldCache::locate(Slot& slot)
+{
+  // A destination off the grid matches no new order, and the slot is free
+  // to be recycled as soon as its followers let go of it
+  int col, row;
+  slot.goal = grid.getCell(slot.to.x, slot.to.z, col, row)
+            ? row * grid.getSize() + col : -1;
+  slot.origin = routes.getCluster(slot.from);
+  if(slot.origin == routes.getCluster(slot.to))
+    slot.origin = -1;
+}
+
+void FlowFieldCache::compute(Slot& slot)
+{
+  // Only integrate the clusters along the route, if there is one. Off the
+  // grid the goal is unreachable, which leaves nothing to follow.
+  int col = -1, row = -1;
+  grid.getCell(slot.to.x, slot.to.z, col, row);
+  if(slot.origin >= 0 && routes.findCorridor(slot.from, slot.to, corridor))
+    slot.field.compute(grid, col, row, &corridor);
+  else
+    slot.field.compute(grid, col, row);
+}
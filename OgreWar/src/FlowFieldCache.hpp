@@ -0,0 +1,90 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FLOWFIELDCACHE_HPP_INCLUDED
+#define FLOWFIELDCACHE_HPP_INCLUDED
+
+#include <atomic>
+#include <deque>
+
+#include "CostGrid.hpp"
+#include "FlowField.hpp"
+#include "HeightField.hpp"
+#include "PathCache.hpp"
+
+// Flow fields by destination cell. Fields stay alive while referenced and
+// the least recently requested unreferenced field is recycled first. Orders
+// from far away only integrate the corridor of clusters their route crosses.
+// Fields in use follow their destination as terrain pages stream in and out.
+class FlowFieldCache
+{
+  /// CONSTANTS
+public:
+  static const unsigned int NONE;
+private:
+  static const int CELLS_PER_PAGE;
+  static const size_t CAPACITY;
+
+  /// NESTING
+private:
+  struct Slot
+  {
+    FlowField field;
+    int goal;                         // Goal cell, -1 if free or off the grid
+    int origin;                       // Cluster ordered from, -1 if anywhere
+    Ogre::Vector3 from, to;           // Where the order was given: these,
+                                      // not goal and origin, survive rebuilds
+    std::atomic<int> refs;            // Waypoints and Soldiers using the field
+    unsigned long last_used;
+    Slot();
+  };
+
+  /// ATTRIBUTES
+private:
+  CostGrid grid;
+  PathCache routes;
+  std::vector<unsigned char> corridor; // Scratch: cells the field may use
+  std::deque<Slot> slots;             // Never moves a Slot once created
+  unsigned long n_requests;
+
+  /// METHODS
+public:
+  // creation, destruction
+  FlowFieldCache();
+  virtual ~FlowFieldCache();
+  void update(const HeightField& terrain);
+  // fields: acquire, retain and update are main thread only, but release
+  // and the queries can be called from any thread during a tick. Retain an
+  // acquired field before acquiring another, or it may be recycled.
+  unsigned int acquire(const Ogre::Vector3& destination,
+                       const Ogre::Vector3* origin = NULL);
+  void retain(unsigned int field);
+  void release(unsigned int field);
+  // query
+  const CostGrid& getCostGrid() const;
+  const PathCache& getRoutes() const;
+  const FlowField& getField(unsigned int field) const;
+  size_t getFieldCount() const;
+
+  /// SUBROUTINES
+private:
+  void locate(Slot& slot);
+  void compute(Slot& slot);
+};
+
+#endif // FLOWFIELDCACHE_HPP_INCLUDED
@@ -0,0 +1,166 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Formation.hpp"
+
+#include <algorithm>
+#include <vector>
+
+using namespace Ogre;
+using namespace std;
+
+/// CONSTANTS
+
+const unsigned int Formation::SHALLOW = 4;
+const Real Formation::DEFAULT_SPACING = 8.0f;
+
+/// UTILITY
+
+static bool inFront(const Formation::Place& a, const Formation::Place& b)
+{
+  return a.forward > b.forward;
+}
+
+static bool toLeft(const Formation::Place& a, const Formation::Place& b)
+{
+  return a.across < b.across;
+}
+
+/// CREATION, DESTRUCTION
+
+Formation::Formation(Shape _shape, Real _spacing) :
+shape(_shape),
+spacing(_spacing)
+{
+}
+
+/// QUERY
+
+unsigned int Formation::getFiles(size_t count) const
+{
+  if(count == 0)
+    return 1;
+  switch(shape)
+  {
+    case LINE:
+      return (count + SHALLOW - 1) / SHALLOW;
+    case COLUMN:
+      return std::min<size_t>(count, SHALLOW);
+    case WEDGE:
+    {
+      // Widest rank at the back: ranks of 1, 3, 5... add up to a square
+      unsigned int ranks = (unsigned int)Math::Ceil(Math::Sqrt(Real(count)));
+      return 2 * ranks - 1;
+    }
+    case SQUARE:
+    default:
+      return (unsigned int)Math::Ceil(Math::Sqrt(Real(count)));
+  }
+}
+
+Real Formation::getSpacing() const
+{
+  return spacing;
+}
+
+void Formation::getSlots(size_t count, Vector3 centre, Vector3 facing,
+                         Real* x, Real* z) const
+{
+  Vector3 forward, right;
+  getAxes(facing, forward, right);
+
+  // The wedge's point leads, each rank reaching one file further out
+  if(shape == WEDGE)
+  {
+    size_t ranks = (size_t)Math::Ceil(Math::Sqrt(Real(count)));
+    Real half_depth = (ranks - 1) * spacing * 0.5f;
+    for(size_t i = 0; i < count; i++)
+    {
+      size_t rank = (size_t)Math::Sqrt(Real(i));
+      while(rank * rank > i)
+        rank--;
+      while((rank + 1) * (rank + 1) <= i)
+        rank++;
+      Real across = (Real(i - rank * rank) - rank) * spacing,
+           behind = rank * spacing - half_depth;
+      x[i] = centre.x + right.x * across - forward.x * behind;
+      z[i] = centre.z + right.z * across - forward.z * behind;
+    }
+    return;
+  }
+
+  // Centre the block of ranks and files on the given point
+  unsigned int files = getFiles(count);
+  size_t ranks = (count + files - 1) / files;
+  Real half_width = (files - 1) * spacing * 0.5f,
+       half_depth = (ranks - 1) * spacing * 0.5f;
+  for(size_t i = 0; i < count; i++)
+  {
+    Real across = (i % files) * spacing - half_width,
+         behind = (i / files) * spacing - half_depth;
+    x[i] = centre.x + right.x * across - forward.x * behind;
+    z[i] = centre.z + right.z * across - forward.z * behind;
+  }
+}
+
+void Formation::assignSlots(size_t count, Vector3 facing,
+                            const Real* from_x, const Real* from_z,
+                            const Real* slot_x, const Real* slot_z,
+                            unsigned int* slot_of) const
+{
+  // Rather than matching everyone to the nearest free slot, which is O(n^2),
+  // sort both sides by depth along the facing, then rank by rank from left
+  // to right: whoever is in front takes the front rank, without crossing
+  Vector3 forward, right;
+  getAxes(facing, forward, right);
+  vector<Place> soldiers(count), slots(count);
+  for(size_t i = 0; i < count; i++)
+  {
+    soldiers[i].forward = from_x[i] * forward.x + from_z[i] * forward.z;
+    soldiers[i].across = from_x[i] * right.x + from_z[i] * right.z;
+    soldiers[i].index = i;
+    slots[i].forward = slot_x[i] * forward.x + slot_z[i] * forward.z;
+    slots[i].across = slot_x[i] * right.x + slot_z[i] * right.z;
+    slots[i].index = i;
+  }
+  stable_sort(soldiers.begin(), soldiers.end(), inFront);
+  stable_sort(slots.begin(), slots.end(), inFront);
+
+  // Slots in the same rank share a depth: pair each rank up side to side
+  Real tolerance = spacing * 0.5f;
+  for(size_t begin = 0, end; begin < count; begin = end)
+  {
+    for(end = begin + 1; end < count
+        && slots[begin].forward - slots[end].forward < tolerance; end++);
+    sort(soldiers.begin() + begin, soldiers.begin() + end, toLeft);
+    sort(slots.begin() + begin, slots.begin() + end, toLeft);
+    for(size_t i = begin; i < end; i++)
+      slot_of[soldiers[i].index] = slots[i].index;
+  }
+}
+
+/// SUBROUTINES
+
+void Formation::getAxes(Vector3 facing, Vector3& forward, Vector3& right)
+{
+  // Work on the ground plane: the front rank faces along 'facing'
+  forward = Vector3(facing.x, 0.0f, facing.z);
+  if(forward.normalise() < 1e-6f)
+    forward = Vector3::NEGATIVE_UNIT_Z;
+  right = Vector3(-forward.z, 0.0f, forward.x);
+}
@@ -0,0 +1,73 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FORMATION_HPP_INCLUDED
+#define FORMATION_HPP_INCLUDED
+
+#include <Ogre.h>
+
+// Arrangement of a group of Soldiers into ranks (rows) and files (columns)
+class Formation
+{
+  /// NESTING
+public:
+  enum Shape
+  {
+    SQUARE,     // as many ranks as files
+    LINE,       // a few ranks deep, wide front
+    COLUMN,     // a few files wide, long and thin
+    WEDGE       // one more file on each side for every rank back
+  };
+  // A position to fill, or somebody to fill it, relative to the formation
+  struct Place
+  {
+    Ogre::Real forward, across;
+    unsigned int index;
+  };
+
+  /// CONSTANTS
+private:
+  static const unsigned int SHALLOW;
+  static const Ogre::Real DEFAULT_SPACING;
+
+  /// ATTRIBUTES
+private:
+  Shape shape;
+  Ogre::Real spacing;   // distance between neighbouring Soldiers
+
+  /// METHODS
+public:
+  // creation, destruction
+  Formation(Shape _shape = SQUARE, Ogre::Real _spacing = DEFAULT_SPACING);
+  // query
+  unsigned int getFiles(size_t count) const;
+  Ogre::Real getSpacing() const;
+  void getSlots(size_t count, Ogre::Vector3 centre, Ogre::Vector3 facing,
+                Ogre::Real* x, Ogre::Real* z) const;
+  void assignSlots(size_t count, Ogre::Vector3 facing,
+                   const Ogre::Real* from_x, const Ogre::Real* from_z,
+                   const Ogre::Real* slot_x, const Ogre::Real* slot_z,
+                   unsigned int* slot_of) const;
+
+  /// SUBROUTINES
+private:
+  static void getAxes(Ogre::Vector3 facing, Ogre::Vector3& forward,
+                      Ogre::Vector3& right);
+};
+
+#endif // FORMATION_HPP_INCLUDED
@@ -0,0 +1,517 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "HeightField.hpp"
+
+#include <algorithm>
+
+using namespace Ogre;
+using namespace std;
+
+/// CREATION, DESTRUCTION
+
+HeightField::HeightField() :
+size(0),
+level_cells(),
+page_world_size(0.0f),
+page_origin(Vector3::ZERO),
+pages(),
+index(),
+index_x(0),
+index_y(0),
+index_cols(0),
+index_rows(0),
+world_size(0.0f),
+origin(Vector3::ZERO),
+revision(0)
+{
+}
+
+HeightField::~HeightField()
+{
+}
+
+void HeightField::import(Image& img, const Terrain::ImportData& settings)
+{
+  size_t n = settings.terrainSize;
+  vector<float> data(n * n);
+
+  // Resample the image to the terrain resolution, as Terrain::prepare does
+  if(img.getWidth() != n || img.getHeight() != n)
+    img.resize(n, n);
+
+  // Images are stored top-down but terrain rows ascend, so flip as we convert
+  for(size_t row = 0; row < n; row++)
+  {
+    unsigned char* src = img.getData() + (n - row - 1) * img.getRowSpan();
+    PixelUtil::bulkPixelConversion(src, img.getFormat(), &data[row * n],
+                                    PF_FLOAT32_R, n);
+  }
+
+  import(&data[0], settings);
+}
+
+void HeightField::import(const float* data, const Terrain::ImportData& settings)
+{
+  // Apply the same scale and bias as the imported terrain
+  size_t n = settings.terrainSize;
+  vector<float> heights(data, data + n * n);
+  for(size_t i = 0; i < heights.size(); i++)
+    heights[i] = heights[i] * settings.inputScale + settings.inputBias;
+  define(n, settings.worldSize, settings.pos, &heights[0]);
+}
+
+void HeightField::copyFrom(const Terrain* terrain)
+{
+  // Mirror the loaded page so queries don't need to go through Ogre
+  addPage(terrain->getSize(), terrain->getWorldSize(), terrain->getPosition(),
+          terrain->getHeightData());
+}
+
+void HeightField::define(size_t _size, Real _world_size, const Vector3& _origin,
+                         const float* data)
+{
+  // A single page, replacing whatever was there before
+  pages.clear();
+  addPage(_size, _world_size, _origin, data);
+}
+
+void HeightField::addPage(size_t _size, Real _world_size,
+                          const Vector3& position, const float* data)
+{
+  // The first page sets out the lattice that the others must sit on
+  if(pages.empty() || _size != size || _world_size != page_world_size)
+  {
+    pages.clear();
+    size = _size;
+    page_world_size = _world_size;
+    page_origin = position;
+
+    // Halve the cells at each level of the pyramid, down to a single one
+    level_cells.assign(1, size - 1);
+    while(level_cells.back() > 1)
+      level_cells.push_back((level_cells.back() + 1) / 2);
+  }
+
+  long x, y;
+  getSlot(position, x, y);
+  vector<Page>::iterator i = pages.begin();
+  while(i != pages.end() && (i->x != x || i->y != y))
+    i++;
+  if(i == pages.end())
+  {
+    pages.push_back(Page());
+    i = pages.end() - 1;
+    i->x = x;
+    i->y = y;
+  }
+  i->heights.assign(data, data + size * size);
+  buildPyramid(*i);
+  rebuildIndex();
+}
+
+void HeightField::removePage(const Vector3& position)
+{
+  if(pages.empty())
+    return;
+
+  long x, y;
+  getSlot(position, x, y);
+  for(vector<Page>::iterator i = pages.begin(); i != pages.end(); i++)
+    if(i->x == x && i->y == y)
+    {
+      pages.erase(i);
+      rebuildIndex();
+      return;
+    }
+}
+
+void HeightField::clear()
+{
+  pages.clear();
+  rebuildIndex();
+}
+
+/// QUERY
+
+bool HeightField::isEmpty() const
+{
+  return pages.empty();
+}
+
+unsigned int HeightField::getRevision() const
+{
+  return revision;
+}
+
+Real HeightField::getWorldSize() const
+{
+  return world_size;
+}
+
+Real HeightField::getPageWorldSize() const
+{
+  return page_world_size;
+}
+
+const Vector3& HeightField::getOrigin() const
+{
+  return origin;
+}
+
+Real HeightField::getHeightAtWorldPosition(const Vector3& position) const
+{
+  Real height;
+  sampleHeights(&position.x, &position.z, &height, 1);
+  return height;
+}
+
+void HeightField::sampleHeights(const Real* x, const Real* z, Real* out,
+                                size_t count) const
+{
+  if(pages.empty())
+  {
+    std::fill(out, out + count, 0.0f);
+    return;
+  }
+
+  // Hoist the world to sample space conversion out of the loop
+  const Real scale = (size - 1) / page_world_size,
+             half = 0.5f * (size - 1);
+  const Real offset_x = half - page_origin.x * scale,
+             offset_y = half + page_origin.z * scale;
+
+  for(size_t i = 0; i < count; i++)
+  {
+    Real fx = x[i] * scale + offset_x,
+         fy = offset_y - z[i] * scale;
+
+    // Like TerrainGroup, report nothing where there is no page
+    const float* data = findPage(fx, fy);
+    if(!data)
+    {
+      out[i] = 0.0f;
+      continue;
+    }
+
+    // Bilinear blend of the four surrounding samples
+    size_t x0 = std::min((size_t)fx, size - 2),
+           y0 = std::min((size_t)fy, size - 2);
+    Real u = fx - x0, v = fy - y0;
+    const float* row0 = data + y0 * size + x0;
+    const float* row1 = row0 + size;
+    Real h0 = row0[0] + (row0[1] - row0[0]) * u,
+         h1 = row1[0] + (row1[1] - row1[0]) * u;
+    out[i] = h0 + (h1 - h0) * v;
+  }
+}
+
+size_t HeightField::getCellIndex(Real x, Real z) const
+{
+  if(pages.empty())
+    return 0;
+
+  // Number cells across the whole index; positions off the edge belong to
+  // the nearest edge cell
+  const long span = (long)size - 1,
+             cols = index_cols * span, rows = index_rows * span;
+  const Real scale = span / page_world_size;
+  Real fx = (x - page_origin.x) * scale + 0.5f * span - index_x * span,
+       fy = (page_origin.z - z) * scale + 0.5f * span - index_y * span;
+  long col = Math::Clamp((long)Math::Floor(fx), 0L, cols - 1),
+       row = Math::Clamp((long)Math::Floor(fy), 0L, rows - 1);
+  return (size_t)(row * cols + col);
+}
+
+bool HeightField::isLineClear(const Vector3& from, const Vector3& to) const
+{
+  // Clear unless the terrain comes between the two ends
+  Real t;
+  return !castRay(from, to - from, 1.0f, t);
+}
+
+bool HeightField::getRayCollision(const Ray& ray, Vector3* out) const
+{
+  Real t;
+  if(!castRay(ray.getOrigin(), ray.getDirection(), Math::POS_INFINITY, t))
+    return false;
+  if(out)
+    (*out) = ray.getPoint(t);
+  return true;
+}
+
+/// SUBROUTINES
+
+void HeightField::getSlot(const Vector3& position, long& x, long& y) const
+{
+  // Pages are centred on their slots: round to the nearest one
+  x = (long)Math::Floor((position.x - page_origin.x) / page_world_size + 0.5f);
+  y = (long)Math::Floor((page_origin.z - position.z) / page_world_size + 0.5f);
+}
+
+void HeightField::rebuildIndex()
+{
+  revision++;
+  index.clear();
+  if(pages.empty())
+  {
+    index_x = index_y = index_cols = index_rows = 0;
+    world_size = 0.0f;
+    origin = Vector3::ZERO;
+    return;
+  }
+
+  // Cover every page, leaving holes where pages are missing
+  long min_x = pages[0].x, max_x = pages[0].x,
+       min_y = pages[0].y, max_y = pages[0].y;
+  for(size_t i = 1; i < pages.size(); i++)
+  {
+    min_x = std::min(min_x, pages[i].x);
+    max_x = std::max(max_x, pages[i].x);
+    min_y = std::min(min_y, pages[i].y);
+    max_y = std::max(max_y, pages[i].y);
+  }
+  index_x = min_x;
+  index_y = min_y;
+  index_cols = max_x - min_x + 1;
+  index_rows = max_y - min_y + 1;
+  index.assign(index_cols * index_rows, NULL);
+  for(size_t i = 0; i < pages.size(); i++)
+    index[(pages[i].y - index_y) * index_cols + (pages[i].x - index_x)] =
+      &pages[i].heights[0];
+
+  // The square that cost grids are laid over
+  world_size = std::max(index_cols, index_rows) * page_world_size;
+  origin = page_origin
+         + Vector3((min_x + max_x) * 0.5f * page_world_size, 0.0f,
+                   -(min_y + max_y) * 0.5f * page_world_size);
+}
+
+const float* HeightField::findPage(Real& fx, Real& fy) const
+{
+  // Turn whole-index sample space into the sample space of a single page
+  const Real span = (Real)(size - 1);
+  long x = (long)Math::Floor(fx / span) - index_x,
+       y = (long)Math::Floor(fy / span) - index_y;
+
+  // The far edges of the last pages still belong to them
+  if(x == index_cols && fx == (index_x + x) * span)
+    x--;
+  if(y == index_rows && fy == (index_y + y) * span)
+    y--;
+  if(x < 0 || x >= index_cols || y < 0 || y >= index_rows)
+    return NULL;
+
+  fx -= (index_x + x) * span;
+  fy -= (index_y + y) * span;
+  return index[y * index_cols + x];
+}
+
+void HeightField::buildPyramid(Page& page) const
+{
+  // Each cell takes the highest of its four corners
+  size_t cells = level_cells[0];
+  page.max_heights.resize(level_cells.size());
+  page.max_heights[0].resize(cells * cells);
+  for(size_t row = 0; row < cells; row++)
+  {
+    const float* row0 = &page.heights[row * size];
+    const float* row1 = row0 + size;
+    float* out = &page.max_heights[0][row * cells];
+    for(size_t col = 0; col < cells; col++)
+      out[col] = std::max(std::max(row0[col], row0[col + 1]),
+                          std::max(row1[col], row1[col + 1]));
+  }
+
+  // Then each level takes the highest of the (up to) four below it
+  for(size_t level = 1; level < level_cells.size(); level++)
+  {
+    size_t below = level_cells[level - 1], n = level_cells[level];
+    const vector<float>& child = page.max_heights[level - 1];
+    vector<float>& parent = page.max_heights[level];
+    parent.assign(n * n, -Math::POS_INFINITY);
+    for(size_t row = 0; row < below; row++)
+      for(size_t col = 0; col < below; col++)
+      {
+        float& h = parent[(row / 2) * n + col / 2];
+        h = std::max(h, child[row * below + col]);
+      }
+  }
+}
+
+bool HeightField::castRay(const Vector3& origin, const Vector3& direction,
+                          Real max_t, Real& t) const
+{
+  if(pages.empty())
+    return false;
+
+  // Work in the sample space of page (0, 0), keeping heights in world units:
+  // the mapping is linear, so distances along the ray are unchanged
+  const Real span = (Real)(size - 1),
+             scale = span / page_world_size,
+             half = 0.5f * span;
+  const Real o[3] = { (origin.x - page_origin.x) * scale + half,
+                      (page_origin.z - origin.z) * scale + half,
+                      origin.y },
+             d[3] = { direction.x * scale, -direction.z * scale, direction.y };
+
+  // Try the pages in the order that the ray reaches them: they don't
+  // overlap, so the first hit is the nearest
+  vector<pair<Real, size_t> > order;
+  for(size_t i = 0; i < pages.size(); i++)
+  {
+    Real t_min = 0.0f, t_max = max_t;
+    Real low[2] = { pages[i].x * span, pages[i].y * span };
+    bool missed = false;
+    for(int axis = 0; axis < 2 && !missed; axis++)
+    {
+      if(d[axis] == 0.0f)
+        missed = (o[axis] < low[axis] || o[axis] > low[axis] + span);
+      else
+      {
+        Real t0 = (low[axis] - o[axis]) / d[axis],
+             t1 = (low[axis] + span - o[axis]) / d[axis];
+        t_min = std::max(t_min, std::min(t0, t1));
+        t_max = std::min(t_max, std::max(t0, t1));
+      }
+    }
+    if(!missed && t_min <= t_max)
+      order.push_back(make_pair(t_min, i));
+  }
+  std::sort(order.begin(), order.end());
+
+  for(size_t i = 0; i < order.size(); i++)
+  {
+    const Page& page = pages[order[i].second];
+    const Real local[3] = { o[0] - page.x * span, o[1] - page.y * span, o[2] };
+    if(castInNode(page, level_cells.size() - 1, 0, 0, local, d, 0.0f, max_t, t))
+      return true;
+  }
+  return false;
+}
+
+bool HeightField::castInNode(const Page& page, size_t level, size_t col,
+                             size_t row, const Real o[3], const Real d[3],
+                             Real t_min, Real t_max, Real& t) const
+{
+  // Clip the ray to the node's cells
+  size_t cells = level_cells[0];
+  Real low[2] = { (Real)(col << level), (Real)(row << level) },
+       high[2] = { (Real)std::min((col + 1) << level, cells),
+                   (Real)std::min((row + 1) << level, cells) };
+  for(int axis = 0; axis < 2; axis++)
+  {
+    if(d[axis] == 0.0f)
+    {
+      if(o[axis] < low[axis] || o[axis] > high[axis])
+        return false;
+      continue;
+    }
+    Real t0 = (low[axis] - o[axis]) / d[axis],
+         t1 = (high[axis] - o[axis]) / d[axis];
+    t_min = std::max(t_min, std::min(t0, t1));
+    t_max = std::min(t_max, std::max(t0, t1));
+  }
+  if(t_min > t_max)
+    return false;
+
+  // Skip the whole node if the ray stays above everything in it
+  Real h_in = o[2] + d[2] * t_min, h_out = o[2] + d[2] * t_max;
+  if(std::min(h_in, h_out) > page.max_heights[level][row * level_cells[level] + col])
+    return false;
+  if(level == 0)
+    return castInCell(page, col, row, o, d, t_min, t_max, t);
+
+  // Otherwise look inside, nearest quarter first. A line crosses at most
+  // one of the two side quarters, so their order doesn't matter.
+  size_t near_col = (d[0] >= 0.0f) ? 0 : 1, near_row = (d[1] >= 0.0f) ? 0 : 1,
+         n = level_cells[level - 1];
+  const size_t quarter[4][2] = { { near_col, near_row },
+                                 { 1 - near_col, near_row },
+                                 { near_col, 1 - near_row },
+                                 { 1 - near_col, 1 - near_row } };
+  for(int q = 0; q < 4; q++)
+  {
+    size_t c = col * 2 + quarter[q][0], r = row * 2 + quarter[q][1];
+    if(c < n && r < n && castInNode(page, level - 1, c, r, o, d, t_min, t_max, t))
+      return true;
+  }
+  return false;
+}
+
+bool HeightField::castInCell(const Page& page, size_t col, size_t row,
+                             const Real o[3], const Real d[3],
+                             Real t_min, Real t_max, Real& t) const
+{
+  // Split the cell into the same two triangles as Terrain, whose diagonal
+  // alternates from row to row
+  const float* h0 = &page.heights[row * size + col];
+  const float* h1 = h0 + size;
+  const Real x0 = (Real)col, x1 = x0 + 1.0f, y0 = (Real)row, y1 = y0 + 1.0f;
+  const Real c00[3] = { x0, y0, h0[0] }, c10[3] = { x1, y0, h0[1] },
+             c01[3] = { x0, y1, h1[0] }, c11[3] = { x1, y1, h1[1] };
+  const Real* triangles[2][3];
+  if(row % 2 == 0)
+  {
+    triangles[0][0] = c00; triangles[0][1] = c10; triangles[0][2] = c11;
+    triangles[1][0] = c00; triangles[1][1] = c11; triangles[1][2] = c01;
+  }
+  else
+  {
+    triangles[0][0] = c00; triangles[0][1] = c10; triangles[0][2] = c01;
+    triangles[1][0] = c10; triangles[1][1] = c11; triangles[1][2] = c01;
+  }
+
+  // Exact ray-triangle test (Moller-Trumbore), keeping the nearer hit. A
+  // little slack keeps rays from slipping between neighbouring cells.
+  static const Real EPSILON = 1e-5f;
+  bool hit = false;
+  for(int i = 0; i < 2; i++)
+  {
+    const Real* a = triangles[i][0];
+    const Real e1[3] = { triangles[i][1][0] - a[0], triangles[i][1][1] - a[1],
+                         triangles[i][1][2] - a[2] },
+               e2[3] = { triangles[i][2][0] - a[0], triangles[i][2][1] - a[1],
+                         triangles[i][2][2] - a[2] };
+    const Real p[3] = { d[1] * e2[2] - d[2] * e2[1],
+                        d[2] * e2[0] - d[0] * e2[2],
+                        d[0] * e2[1] - d[1] * e2[0] };
+    Real det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+    if(det == 0.0f)
+      continue;
+    Real inv_det = 1.0f / det;
+    const Real s[3] = { o[0] - a[0], o[1] - a[1], o[2] - a[2] };
+    Real u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inv_det;
+    if(u < -EPSILON || u > 1.0f + EPSILON)
+      continue;
+    const Real q[3] = { s[1] * e1[2] - s[2] * e1[1],
+                        s[2] * e1[0] - s[0] * e1[2],
+                        s[0] * e1[1] - s[1] * e1[0] };
+    Real v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * inv_det;
+    if(v < -EPSILON || u + v > 1.0f + EPSILON)
+      continue;
+    Real t_hit = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inv_det;
+    if(t_hit >= t_min - EPSILON && t_hit <= t_max + EPSILON
+    && (!hit || t_hit < t))
+    {
+      t = t_hit;
+      hit = true;
+    }
+  }
+  return hit;
+}
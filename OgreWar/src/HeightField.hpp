@@ -0,0 +1,98 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef HEIGHTFIELD_HPP_INCLUDED
+#define HEIGHTFIELD_HPP_INCLUDED
+
+#include <vector>
+
+#include <Ogre.h>
+#include <OGRE/Terrain/OgreTerrain.h>
+
+class HeightField
+{
+  /// NESTING
+private:
+  // One terrain page worth of samples, on the lattice of page (0, 0)
+  struct Page
+  {
+    long x, y;                  // Slot, as in the TerrainGroup
+    std::vector<float> heights; // Row-major samples, ascending terrain-space y
+    // Highest sample under each cell, then under each 2x2 block of those and
+    // so on up to the whole page, for rays to skip over
+    std::vector<std::vector<float> > max_heights;
+  };
+
+  /// ATTRIBUTES
+private:
+  size_t size;                // Number of samples along each side of a page
+  std::vector<size_t> level_cells; // Cells along each side, per pyramid level
+  Ogre::Real page_world_size; // Length of each side of a page in world units
+  Ogre::Vector3 page_origin;  // World position of the centre of page (0, 0)
+  std::vector<Page> pages;    // Only the pages that are resident
+  std::vector<const float*> index; // Page samples by slot, NULL where missing
+  long index_x, index_y;      // Slot of the first page in the index
+  long index_cols, index_rows;// Number of slots covered by the index
+  Ogre::Real world_size;      // Side of the square covering every page
+  Ogre::Vector3 origin;       // World position of the centre of that square
+  unsigned int revision;      // Bumped whenever the heights change
+
+  /// METHODS
+public:
+  // creation, destruction
+  HeightField();
+  virtual ~HeightField();
+  void import(Ogre::Image& img, const Ogre::Terrain::ImportData& settings);
+  void import(const float* data, const Ogre::Terrain::ImportData& settings);
+  void copyFrom(const Ogre::Terrain* terrain);
+  void define(size_t _size, Ogre::Real _world_size, const Ogre::Vector3& _origin,
+              const float* data);
+  void addPage(size_t _size, Ogre::Real _world_size,
+               const Ogre::Vector3& position, const float* data);
+  void removePage(const Ogre::Vector3& position);
+  void clear();
+  // query
+  bool isEmpty() const;
+  unsigned int getRevision() const;
+  Ogre::Real getWorldSize() const;
+  Ogre::Real getPageWorldSize() const;
+  const Ogre::Vector3& getOrigin() const;
+  Ogre::Real getHeightAtWorldPosition(const Ogre::Vector3& position) const;
+  void sampleHeights(const Ogre::Real* x, const Ogre::Real* z,
+                     Ogre::Real* out, size_t count) const;
+  size_t getCellIndex(Ogre::Real x, Ogre::Real z) const;
+  bool isLineClear(const Ogre::Vector3& from, const Ogre::Vector3& to) const;
+  bool getRayCollision(const Ogre::Ray& ray, Ogre::Vector3* out = NULL) const;
+
+  /// SUBROUTINES
+private:
+  void getSlot(const Ogre::Vector3& position, long& x, long& y) const;
+  void rebuildIndex();
+  const float* findPage(Ogre::Real& fx, Ogre::Real& fy) const;
+  void buildPyramid(Page& page) const;
+  bool castRay(const Ogre::Vector3& origin, const Ogre::Vector3& direction,
+               Ogre::Real max_t, Ogre::Real& t) const;
+  bool castInNode(const Page& page, size_t level, size_t col, size_t row,
+                  const Ogre::Real o[3], const Ogre::Real d[3],
+                  Ogre::Real t_min, Ogre::Real t_max, Ogre::Real& t) const;
+  bool castInCell(const Page& page, size_t col, size_t row,
+                  const Ogre::Real o[3], const Ogre::Real d[3],
+                  Ogre::Real t_min, Ogre::Real t_max, Ogre::Real& t) const;
+};
+
+#endif // HEIGHTFIELD_HPP_INCLUDED
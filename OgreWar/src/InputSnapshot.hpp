@@ -0,0 +1,37 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef INPUTSNAPSHOT_HPP_INCLUDED
+#define INPUTSNAPSHOT_HPP_INCLUDED
+
+#include <Ogre.h>
+
+// Where the cursor points this frame, worked out once however many mouse
+// events arrive, for the camera, selection and orders to share
+struct InputSnapshot
+{
+  Ogre::Vector2 cursor;   // From (0, 0) top-left to (1, 1) bottom-right
+  Ogre::Ray ray;          // From the camera through the cursor
+  bool over_terrain;      // True if the ray hits the terrain...
+  Ogre::Vector3 focus;    // ...in which case this is where
+
+  InputSnapshot() :
+  cursor(Ogre::Vector2::ZERO), ray(), over_terrain(false),
+  focus(Ogre::Vector3::ZERO) {}
+};
+
+#endif // INPUTSNAPSHOT_HPP_INCLUDED
@@ -0,0 +1,229 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "JobSystem.hpp"
+
+using namespace std;
+
+/// CREATION, DESTRUCTION
+
+JobSystem::JobSystem(unsigned int n_workers) :
+workers(),
+queues(),
+background(),
+wake_lock(),
+wake(),
+queued(0),
+quit(false)
+{
+  // One queue for the calling thread plus one per worker
+  for(unsigned int i = 0; i <= n_workers; i++)
+    queues.push_back(new Queue());
+  for(unsigned int i = 1; i <= n_workers; i++)
+    workers.push_back(thread(&JobSystem::workerLoop, this, i));
+}
+
+JobSystem::~JobSystem()
+{
+  // Wake everyone up and wait for them to leave
+  {
+    lock_guard<mutex> guard(wake_lock);
+    quit = true;
+  }
+  wake.notify_all();
+  for(size_t i = 0; i < workers.size(); i++)
+    workers[i].join();
+
+  for(size_t i = 0; i < queues.size(); i++)
+    delete queues[i];
+}
+
+unsigned int JobSystem::defaultWorkerCount()
+{
+  // Leave one hardware thread for the caller, which also does work
+  unsigned int n_threads = thread::hardware_concurrency();
+  return (n_threads > 1) ? n_threads - 1 : 0;
+}
+
+/// EXECUTION
+
+void JobSystem::parallelFor(Job& job, size_t count, size_t grain)
+{
+  if(grain == 0)
+    grain = 1;
+
+  // Not worth waking anybody up for a single chunk
+  if(workers.empty() || count <= grain)
+  {
+    job.run(0, count);
+    return;
+  }
+
+  // Help out until every chunk is finished
+  atomic<size_t> remaining(0);
+  enqueue(job, count, grain, remaining, false);
+  helpUntil(remaining, false);
+}
+
+void JobSystem::submit(Job& job, size_t count, size_t grain, Batch& batch)
+{
+  if(grain == 0)
+    grain = 1;
+
+  // Nobody else to do it: get it over with now
+  if(workers.empty())
+  {
+    job.run(0, count);
+    return;
+  }
+
+  // The workers pick the chunks up while the caller gets on with its frame
+  enqueue(job, count, grain, batch.remaining, true);
+}
+
+void JobSystem::wait(Batch& batch)
+{
+  // The caller is stuck anyway, so it may as well lend a hand
+  helpUntil(batch.remaining, true);
+}
+
+JobSystem::Batch::Batch() :
+remaining(0)
+{
+}
+
+bool JobSystem::Batch::isDone() const
+{
+  return (remaining == 0);
+}
+
+/// QUERY
+
+unsigned int JobSystem::getThreadCount() const
+{
+  return workers.size() + 1;
+}
+
+/// SUBROUTINES
+
+void JobSystem::enqueue(Job& job, size_t count, size_t grain,
+                        atomic<size_t>& remaining, bool deferred)
+{
+  // Deal the chunks out across all the queues, or leave deferred ones to one
+  // side where only the workers (and whoever waits for them) will look
+  size_t n_tasks = (count + grain - 1) / grain;
+  remaining += n_tasks;
+
+  // Count the tasks in before anybody can take one, or the count could
+  // briefly wrap below zero and keep the workers from going back to sleep
+  {
+    lock_guard<mutex> guard(wake_lock);
+    queued += n_tasks;
+  }
+  for(size_t t = 0; t < n_tasks; t++)
+  {
+    Task task = { &job, t * grain, min(count, (t + 1) * grain), &remaining };
+    Queue* queue = deferred ? &background : queues[t % queues.size()];
+    lock_guard<mutex> guard(queue->lock);
+    queue->tasks.push_back(task);
+  }
+  wake.notify_all();
+}
+
+void JobSystem::helpUntil(const atomic<size_t>& remaining, bool deferred)
+{
+  // Work on anything queued, stealing once our own queue is dry
+  Task task;
+  while(remaining > 0)
+  {
+    if(takeTask(0, deferred, task))
+      runTask(task);
+    else
+      this_thread::yield();
+  }
+}
+
+void JobSystem::workerLoop(unsigned int index)
+{
+  Task task;
+  while(true)
+  {
+    // Sleep until there is something to pick up
+    {
+      unique_lock<mutex> guard(wake_lock);
+      while(!quit && queued == 0)
+        wake.wait(guard);
+      if(quit)
+        return;
+    }
+
+    // Work through our own queue, then steal from the others
+    while(takeTask(index, true, task))
+      runTask(task);
+  }
+}
+
+bool JobSystem::takeTask(unsigned int index, bool deferred, Task& out)
+{
+  // Newest task from our own queue: its data is likely still in cache
+  {
+    Queue* own = queues[index];
+    lock_guard<mutex> guard(own->lock);
+    if(!own->tasks.empty())
+    {
+      out = own->tasks.back();
+      own->tasks.pop_back();
+      queued--;
+      return true;
+    }
+  }
+
+  // Oldest task from somebody else's queue
+  for(size_t i = 1; i < queues.size(); i++)
+  {
+    Queue* victim = queues[(index + i) % queues.size()];
+    lock_guard<mutex> guard(victim->lock);
+    if(!victim->tasks.empty())
+    {
+      out = victim->tasks.front();
+      victim->tasks.pop_front();
+      queued--;
+      return true;
+    }
+  }
+
+  // Submitted work last, so that it never holds up a parallelFor
+  if(deferred)
+  {
+    lock_guard<mutex> guard(background.lock);
+    if(!background.tasks.empty())
+    {
+      out = background.tasks.front();
+      background.tasks.pop_front();
+      queued--;
+      return true;
+    }
+  }
+  return false;
+}
+
+void JobSystem::runTask(const Task& task)
+{
+  task.job->run(task.begin, task.end);
+  (*task.remaining)--;
+}
@@ -0,0 +1,97 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef JOBSYSTEM_HPP_INCLUDED
+#define JOBSYSTEM_HPP_INCLUDED
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem
+{
+  /// NESTING
+public:
+  // Work that can be split into independent index ranges
+  class Job
+  {
+  public:
+    virtual ~Job() {}
+    virtual void run(size_t begin, size_t end) = 0;
+  };
+  // Tracks work handed out by submit, which returns without waiting for it
+  class Batch
+  {
+  public:
+    Batch();
+    bool isDone() const;
+  private:
+    std::atomic<size_t> remaining;  // chunks not yet finished
+    friend class JobSystem;
+  };
+private:
+  struct Task
+  {
+    Job* job;
+    size_t begin, end;
+    std::atomic<size_t>* remaining;
+  };
+  // Owner pops from the back, thieves steal from the front
+  struct Queue
+  {
+    std::mutex lock;
+    std::deque<Task> tasks;
+  };
+
+  /// ATTRIBUTES
+private:
+  std::vector<std::thread> workers;
+  std::vector<Queue*> queues;       // queues[0] belongs to the calling thread
+  Queue background;                 // submitted work, left to the workers
+  std::mutex wake_lock;
+  std::condition_variable wake;
+  std::atomic<size_t> queued;       // tasks waiting to be picked up
+  bool quit;
+
+  /// METHODS
+public:
+  // creation, destruction
+  JobSystem(unsigned int n_workers = defaultWorkerCount());
+  virtual ~JobSystem();
+  static unsigned int defaultWorkerCount();
+  // execution
+  void parallelFor(Job& job, size_t count, size_t grain);
+  void submit(Job& job, size_t count, size_t grain, Batch& batch);
+  void wait(Batch& batch);
+  // query
+  unsigned int getThreadCount() const;
+
+  /// SUBROUTINES
+private:
+  void enqueue(Job& job, size_t count, size_t grain,
+               std::atomic<size_t>& remaining, bool deferred);
+  void helpUntil(const std::atomic<size_t>& remaining, bool deferred);
+  void workerLoop(unsigned int index);
+  bool takeTask(unsigned int index, bool deferred, Task& out);
+  void runTask(const Task& task);
+};
+
+#endif // JOBSYSTEM_HPP_INCLUDED
@@ -0,0 +1,158 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "LineOfSight.hpp"
+
+using namespace Ogre;
+using namespace std;
+
+/// CONSTANTS
+
+// sight lines run from eye to eye, about the height of a Soldier's head
+const Real LineOfSight::EYE_HEIGHT = 8.0f;
+// forget everything rather than grow without bound
+const size_t LineOfSight::MAX_CACHED = 1 << 20;
+const size_t LineOfSight::TRACE_GRAIN = 64;
+// cache values from here up are the index of a miss being traced
+const unsigned int LineOfSight::PENDING = 2;
+// queries answered straight from the cache need no miss
+const unsigned int LineOfSight::CACHED = (unsigned int)-1;
+
+/// CREATION, DESTRUCTION
+
+LineOfSight::LineOfSight() :
+cache(),
+revision(0),
+miss_key(),
+from_x(), from_y(), from_z(), to_x(), to_y(), to_z(),
+miss_visible(),
+answer(),
+n_queries(0),
+n_traces(0)
+{
+}
+
+LineOfSight::~LineOfSight()
+{
+}
+
+void LineOfSight::clear()
+{
+  cache.clear();
+}
+
+/// QUERY
+
+void LineOfSight::check(const HeightField& terrain, JobSystem& jobs,
+                        size_t count, const Real* _from_x, const Real* _from_z,
+                        const Real* _to_x, const Real* _to_z,
+                        unsigned char* visible)
+{
+  // Answers traced over other heights are no good
+  if(revision != terrain.getRevision() || cache.size() > MAX_CACHED)
+  {
+    cache.clear();
+    revision = terrain.getRevision();
+  }
+
+  // Look everybody up first, so that each new cell pair is traced only once
+  // however many queries share it. Sight is symmetric: order the pair.
+  miss_key.clear();
+  from_x.clear();
+  from_z.clear();
+  to_x.clear();
+  to_z.clear();
+  answer.resize(count);
+  for(size_t i = 0; i < count; i++)
+  {
+    unsigned long long a = terrain.getCellIndex(_from_x[i], _from_z[i]),
+                       b = terrain.getCellIndex(_to_x[i], _to_z[i]);
+    unsigned long long key = (a < b) ? ((a << 32) | b) : ((b << 32) | a);
+    pair<VisibilityMap::iterator, bool> found =
+      cache.insert(VisibilityMap::value_type(key, PENDING + miss_key.size()));
+    if(found.second)
+    {
+      miss_key.push_back(key);
+      from_x.push_back(_from_x[i]);
+      from_z.push_back(_from_z[i]);
+      to_x.push_back(_to_x[i]);
+      to_z.push_back(_to_z[i]);
+    }
+    if(found.first->second < PENDING)
+    {
+      visible[i] = (unsigned char)found.first->second;
+      answer[i] = CACHED;
+    }
+    else
+      answer[i] = found.first->second - PENDING;
+  }
+
+  // Trace the misses, which only read the terrain, on any thread
+  size_t n_misses = miss_key.size();
+  from_y.resize(n_misses);
+  to_y.resize(n_misses);
+  miss_visible.resize(n_misses);
+  TraceJob job;
+  job.sight = this;
+  job.terrain = &terrain;
+  jobs.parallelFor(job, n_misses, TRACE_GRAIN);
+
+  // Remember the new answers and hand them out
+  for(size_t m = 0; m < n_misses; m++)
+    cache[miss_key[m]] = miss_visible[m];
+  for(size_t i = 0; i < count; i++)
+    if(answer[i] != CACHED)
+      visible[i] = miss_visible[answer[i]];
+
+  n_queries += count;
+  n_traces += n_misses;
+}
+
+size_t LineOfSight::getQueryCount() const
+{
+  return n_queries;
+}
+
+size_t LineOfSight::getTraceCount() const
+{
+  return n_traces;
+}
+
+/// SUBROUTINES
+
+void LineOfSight::TraceJob::run(size_t begin, size_t end)
+{
+  sight->traceRange(begin, end, *terrain);
+}
+
+void LineOfSight::traceRange(size_t begin, size_t end,
+                             const HeightField& terrain)
+{
+  if(begin == end)
+    return;
+
+  // Raise both ends off the ground in one batch each
+  terrain.sampleHeights(&from_x[begin], &from_z[begin], &from_y[begin],
+                        end - begin);
+  terrain.sampleHeights(&to_x[begin], &to_z[begin], &to_y[begin],
+                        end - begin);
+  for(size_t m = begin; m < end; m++)
+    miss_visible[m] = terrain.isLineClear(
+                        Vector3(from_x[m], from_y[m] + EYE_HEIGHT, from_z[m]),
+                        Vector3(to_x[m], to_y[m] + EYE_HEIGHT, to_z[m]));
+}
@@ -0,0 +1,88 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LINEOFSIGHT_HPP_INCLUDED
+#define LINEOFSIGHT_HPP_INCLUDED
+
+#include <vector>
+
+#include <Ogre.h>
+
+#include "HeightField.hpp"
+#include "JobSystem.hpp"
+
+// Answers "can A see B over the terrain" in batches, tracing each new pair of
+// HeightField cells on the JobSystem and remembering the answer until the
+// heights change
+class LineOfSight
+{
+  /// CONSTANTS
+public:
+  static const Ogre::Real EYE_HEIGHT;
+private:
+  static const size_t MAX_CACHED;
+  static const size_t TRACE_GRAIN;
+  static const unsigned int PENDING;
+  static const unsigned int CACHED;
+
+  /// NESTING
+private:
+  typedef HashMap<unsigned long long, unsigned int> VisibilityMap;
+  // Traces a range of cache misses on a worker thread
+  class TraceJob : public JobSystem::Job
+  {
+  public:
+    LineOfSight* sight;
+    const HeightField* terrain;
+    void run(size_t begin, size_t end);
+  };
+
+  /// ATTRIBUTES
+private:
+  // cell pair -> visible or not, or which miss will say so during a batch
+  VisibilityMap cache;
+  unsigned int revision;              // HeightField the cache was traced over
+  // scratch space for the cell pairs traced this batch, one entry per miss
+  std::vector<unsigned long long> miss_key;
+  std::vector<Ogre::Real> from_x, from_y, from_z, to_x, to_y, to_z;
+  std::vector<unsigned char> miss_visible;
+  // scratch space for which miss answers each query, CACHED if none does
+  std::vector<unsigned int> answer;
+  // statistics
+  size_t n_queries, n_traces;
+
+  /// METHODS
+public:
+  // creation, destruction
+  LineOfSight();
+  virtual ~LineOfSight();
+  void clear();
+  // query
+  void check(const HeightField& terrain, JobSystem& jobs, size_t count,
+             const Ogre::Real* _from_x, const Ogre::Real* _from_z,
+             const Ogre::Real* _to_x, const Ogre::Real* _to_z,
+             unsigned char* visible);
+  size_t getQueryCount() const;
+  size_t getTraceCount() const;
+
+  /// SUBROUTINES
+private:
+  void traceRange(size_t begin, size_t end, const HeightField& terrain);
+};
+
+#endif // LINEOFSIGHT_HPP_INCLUDED
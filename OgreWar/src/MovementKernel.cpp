@@ -0,0 +1,204 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "MovementKernel.hpp"
+
+#ifdef MOVEMENTKERNEL_SSE
+  #include <xmmintrin.h>
+#endif
+#ifdef MOVEMENTKERNEL_AVX2
+  #include <immintrin.h>
+#endif
+
+using namespace Ogre;
+
+/// QUERY
+
+MovementKernel::InstructionSet MovementKernel::getBestInstructionSet()
+{
+#ifdef MOVEMENTKERNEL_AVX2
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  if(has_avx2)
+    return AVX2;
+#endif
+#ifdef MOVEMENTKERNEL_SSE
+  return SSE;
+#else
+  return SCALAR;
+#endif
+}
+
+const char* MovementKernel::getName(InstructionSet isa)
+{
+  switch(isa)
+  {
+    case AVX2: return "AVX2";
+    case SSE: return "SSE";
+    default: return "scalar";
+  }
+}
+
+/// UPDATE
+
+size_t MovementKernel::advance(size_t count, Real move,
+                              Real* pos_x, Real* pos_z,
+                              const Real* dir_x, const Real* dir_z,
+                              const Real* dest_x, const Real* dest_z,
+                              Real* distance_left, unsigned int* arrived,
+                              InstructionSet isa)
+{
+  // Never use an instruction set this build or this CPU lacks
+  if(isa > getBestInstructionSet())
+    isa = getBestInstructionSet();
+
+  switch(isa)
+  {
+#ifdef MOVEMENTKERNEL_AVX2
+    case AVX2:
+      return advanceAVX2(count, move, pos_x, pos_z, dir_x, dir_z,
+                        dest_x, dest_z, distance_left, arrived);
+#endif
+#ifdef MOVEMENTKERNEL_SSE
+    case SSE:
+      return advanceSSE(count, move, pos_x, pos_z, dir_x, dir_z,
+                        dest_x, dest_z, distance_left, arrived);
+#endif
+    default:
+      return advanceScalar(0, count, move, pos_x, pos_z, dir_x, dir_z,
+                            dest_x, dest_z, distance_left, arrived);
+  }
+}
+
+/// SUBROUTINES
+
+size_t MovementKernel::advanceScalar(size_t begin, size_t count, Real move,
+                              Real* pos_x, Real* pos_z,
+                              const Real* dir_x, const Real* dir_z,
+                              const Real* dest_x, const Real* dest_z,
+                              Real* distance_left, unsigned int* arrived)
+{
+  size_t n_arrived = 0;
+  for(size_t i = begin; i < count; i++)
+  {
+    // Decrement the amount of distance left to move
+    Real left = distance_left[i] - move;
+    distance_left[i] = left;
+    if(left <= 0.0f)
+    {
+      // Jump to target position if an overlap occurs
+      pos_x[i] = dest_x[i];
+      pos_z[i] = dest_z[i];
+      arrived[n_arrived++] = i;
+    }
+    else
+    {
+      pos_x[i] += dir_x[i] * move;
+      pos_z[i] += dir_z[i] * move;
+    }
+  }
+  return n_arrived;
+}
+
+#ifdef MOVEMENTKERNEL_SSE
+size_t MovementKernel::advanceSSE(size_t count, Real move,
+                              Real* pos_x, Real* pos_z,
+                              const Real* dir_x, const Real* dir_z,
+                              const Real* dest_x, const Real* dest_z,
+                              Real* distance_left, unsigned int* arrived)
+{
+  const __m128 v_move = _mm_set1_ps(move),
+               v_zero = _mm_setzero_ps();
+  size_t n_arrived = 0, i = 0;
+  for(; i + 4 <= count; i += 4)
+  {
+    // Decrement the amount of distance left to move
+    __m128 left = _mm_sub_ps(_mm_loadu_ps(distance_left + i), v_move);
+    _mm_storeu_ps(distance_left + i, left);
+    __m128 done = _mm_cmple_ps(left, v_zero);
+
+    // Step along the direction, or jump to the destination on arrival
+    __m128 x = _mm_add_ps(_mm_loadu_ps(pos_x + i),
+                          _mm_mul_ps(_mm_loadu_ps(dir_x + i), v_move)),
+           z = _mm_add_ps(_mm_loadu_ps(pos_z + i),
+                          _mm_mul_ps(_mm_loadu_ps(dir_z + i), v_move));
+    x = _mm_or_ps(_mm_and_ps(done, _mm_loadu_ps(dest_x + i)),
+                  _mm_andnot_ps(done, x));
+    z = _mm_or_ps(_mm_and_ps(done, _mm_loadu_ps(dest_z + i)),
+                  _mm_andnot_ps(done, z));
+    _mm_storeu_ps(pos_x + i, x);
+    _mm_storeu_ps(pos_z + i, z);
+
+    // Compact the lanes that arrived into the output list
+    int mask = _mm_movemask_ps(done);
+    for(unsigned int lane = 0; mask; lane++, mask >>= 1)
+      if(mask & 1)
+        arrived[n_arrived++] = i + lane;
+  }
+
+  // Finish off whatever doesn't fill a register
+  return n_arrived + advanceScalar(i, count, move, pos_x, pos_z, dir_x, dir_z,
+                                   dest_x, dest_z, distance_left,
+                                   arrived + n_arrived);
+}
+#endif
+
+#ifdef MOVEMENTKERNEL_AVX2
+__attribute__((target("avx2")))
+size_t MovementKernel::advanceAVX2(size_t count, Real move,
+                              Real* pos_x, Real* pos_z,
+                              const Real* dir_x, const Real* dir_z,
+                              const Real* dest_x, const Real* dest_z,
+                              Real* distance_left, unsigned int* arrived)
+{
+  const __m256 v_move = _mm256_set1_ps(move),
+               v_zero = _mm256_setzero_ps();
+  size_t n_arrived = 0, i = 0;
+  for(; i + 8 <= count; i += 8)
+  {
+    // Decrement the amount of distance left to move
+    __m256 left = _mm256_sub_ps(_mm256_loadu_ps(distance_left + i), v_move);
+    _mm256_storeu_ps(distance_left + i, left);
+    __m256 done = _mm256_cmp_ps(left, v_zero, _CMP_LE_OQ);
+
+    // Step along the direction, or jump to the destination on arrival
+    __m256 x = _mm256_add_ps(_mm256_loadu_ps(pos_x + i),
+                          _mm256_mul_ps(_mm256_loadu_ps(dir_x + i), v_move)),
+           z = _mm256_add_ps(_mm256_loadu_ps(pos_z + i),
+                          _mm256_mul_ps(_mm256_loadu_ps(dir_z + i), v_move));
+    x = _mm256_blendv_ps(x, _mm256_loadu_ps(dest_x + i), done);
+    z = _mm256_blendv_ps(z, _mm256_loadu_ps(dest_z + i), done);
+    _mm256_storeu_ps(pos_x + i, x);
+    _mm256_storeu_ps(pos_z + i, z);
+
+    // Compact the lanes that arrived into the output list
+    int mask = _mm256_movemask_ps(done);
+    for(unsigned int lane = 0; mask; lane++, mask >>= 1)
+      if(mask & 1)
+        arrived[n_arrived++] = i + lane;
+  }
+
+  // Clear the upper halves before running non-VEX code, which would
+  // otherwise pay for a state transition on every SSE instruction
+  _mm256_zeroupper();
+
+  // Finish off whatever doesn't fill a register
+  return n_arrived + advanceScalar(i, count, move, pos_x, pos_z, dir_x, dir_z,
+                                   dest_x, dest_z, distance_left,
+                                   arrived + n_arrived);
+}
+#endif
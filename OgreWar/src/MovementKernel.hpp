@@ -0,0 +1,79 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MOVEMENTKERNEL_HPP_INCLUDED
+#define MOVEMENTKERNEL_HPP_INCLUDED
+
+#include <Ogre.h>
+
+// SSE needs single precision reals and an x86 compiler that targets it
+#if OGRE_DOUBLE_PRECISION == 0 && (defined(__SSE__) || defined(_M_X64) \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+  #define MOVEMENTKERNEL_SSE
+#endif
+// AVX2 is compiled in per function and only used if the CPU reports it
+#if defined(MOVEMENTKERNEL_SSE) && defined(__GNUC__)
+  #define MOVEMENTKERNEL_AVX2
+#endif
+
+class MovementKernel
+{
+  /// NESTING
+public:
+  enum InstructionSet
+  {
+    SCALAR, SSE, AVX2
+  };
+
+  /// METHODS
+public:
+  // query
+  static InstructionSet getBestInstructionSet();
+  static const char* getName(InstructionSet isa);
+  // update
+  static size_t advance(size_t count, Ogre::Real move,
+                        Ogre::Real* pos_x, Ogre::Real* pos_z,
+                        const Ogre::Real* dir_x, const Ogre::Real* dir_z,
+                        const Ogre::Real* dest_x, const Ogre::Real* dest_z,
+                        Ogre::Real* distance_left, unsigned int* arrived,
+                        InstructionSet isa = getBestInstructionSet());
+
+  /// SUBROUTINES
+private:
+  static size_t advanceScalar(size_t begin, size_t count, Ogre::Real move,
+                        Ogre::Real* pos_x, Ogre::Real* pos_z,
+                        const Ogre::Real* dir_x, const Ogre::Real* dir_z,
+                        const Ogre::Real* dest_x, const Ogre::Real* dest_z,
+                        Ogre::Real* distance_left, unsigned int* arrived);
+#ifdef MOVEMENTKERNEL_SSE
+  static size_t advanceSSE(size_t count, Ogre::Real move,
+                        Ogre::Real* pos_x, Ogre::Real* pos_z,
+                        const Ogre::Real* dir_x, const Ogre::Real* dir_z,
+                        const Ogre::Real* dest_x, const Ogre::Real* dest_z,
+                        Ogre::Real* distance_left, unsigned int* arrived);
+#endif
+#ifdef MOVEMENTKERNEL_AVX2
+  static size_t advanceAVX2(size_t count, Ogre::Real move,
+                        Ogre::Real* pos_x, Ogre::Real* pos_z,
+                        const Ogre::Real* dir_x, const Ogre::Real* dir_z,
+                        const Ogre::Real* dest_x, const Ogre::Real* dest_z,
+                        Ogre::Real* distance_left, unsigned int* arrived);
+#endif
+};
+
+#endif // MOVEMENTKERNEL_HPP_INCLUDED
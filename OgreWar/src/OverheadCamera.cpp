@@ -18,7 +18,6 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "OverheadCamera.hpp"
 
-#include <CEGUI/CEGUI.h> // for CEGUI::MouseCursor
 #include <iostream>
 
 #define SIGN(x) ((x>0)?1:((x<0)?-1:0))
@@ -46,6 +45,7 @@ pan_speed(Vector3::ZERO),
 zoom_speed(Vector3::ZERO),
 input(Vector3::ZERO),
 zoom_direction(Vector3::ZERO),
+zoom_input(0),
 target(NULL)
 {
   // Set the camera to look at our handiwork
@@ -61,8 +61,12 @@ OverheadCamera::~OverheadCamera()
 
 /// UPDATE
 
-bool OverheadCamera::frameRenderingQueued(const FrameEvent& evt)
+bool OverheadCamera::frameRenderingQueued(const FrameEvent& evt,
+                                          const Ray& cursor_ray)
 {
+  // zoom towards the cursor based on the mouse wheel
+  zoom(cursor_ray);
+
   // pan the camera based on keyboard input
   move(evt.timeSinceLastFrame);
 
@@ -147,24 +151,8 @@ void OverheadCamera::injectMouseMove(const OIS::MouseEvent& evt)
     camera->moveRelative(Vector3(0, 0, distance));
   }
 
-  // Calculate the direction towards the cursor
-  CEGUI::Point mouse_pos = CEGUI::MouseCursor::getSingleton().getPosition();
-  Ray mouse_ray =
-    camera->getCameraToViewportRay(mouse_pos.d_x/float(evt.state.width),
-                                   mouse_pos.d_y/float(evt.state.height));
-
-  // Cap maximum zoom
-  bool zoom_in = evt.state.Z.rel > 0,
-       zoom_out = evt.state.Z.rel < 0;
-  if(zoom_in || (!zoom_out && camera->getPosition().y > MIN_Y))
-    max_zoom_out = false;
-  else if(zoom_out || (!zoom_in && camera->getPosition().y < MAX_Y))
-    max_zoom_in = false;
-
-  // Otherwise zoom towards cursor
-  if((zoom_in && !max_zoom_in) || (zoom_out && !max_zoom_out))
-      zoom_speed += mouse_ray.getDirection() * evt.state.Z.rel * 50;
-
+  // Zoom once a frame, however many wheel events arrive
+  zoom_input += evt.state.Z.rel;
 }
 
 void OverheadCamera::injectMouseUp(const OIS::MouseEvent& evt, OIS::MouseButtonID id)
@@ -256,6 +244,22 @@ void OverheadCamera::move(Real d_time)
     camera->move(zoom_speed * height_mod * d_time);
 }
 
+void OverheadCamera::zoom(const Ray& cursor_ray)
+{
+  // Cap maximum zoom
+  bool zoom_in = zoom_input > 0,
+       zoom_out = zoom_input < 0;
+  if(zoom_in || (!zoom_out && camera->getPosition().y > MIN_Y))
+    max_zoom_out = false;
+  else if(zoom_out || (!zoom_in && camera->getPosition().y < MAX_Y))
+    max_zoom_in = false;
+
+  // Otherwise zoom towards cursor
+  if((zoom_in && !max_zoom_in) || (zoom_out && !max_zoom_out))
+      zoom_speed += cursor_ray.getDirection() * zoom_input * 50;
+  zoom_input = 0;
+}
+
 void OverheadCamera::stayOnSide(Real target_y, Real d_time, int side)
 {
   // sign must be 1 or -1
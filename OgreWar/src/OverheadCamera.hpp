@@ -39,6 +39,7 @@ private:
   Ogre::Camera* camera;
   Ogre::Real top_speed, orbit_speed;
   Ogre::Vector3 pan_speed, zoom_speed, input, zoom_direction;
+  int zoom_input;         // Mouse wheel movement since the last frame
   Ogre::SceneNode* target;
 
   /// METHODS
@@ -53,7 +54,8 @@ public:
   Ogre::Camera* getCamera();
   Ogre::Real getTopSpeed() const;
   // update
-  virtual bool frameRenderingQueued(const Ogre::FrameEvent& evt);
+  virtual bool frameRenderingQueued(const Ogre::FrameEvent& evt,
+                                    const Ogre::Ray& cursor_ray);
   // control
   void stopPan();
   void stopZoom();
@@ -69,6 +71,7 @@ public:
   /// SUBROUTINES
 private:
   void move(Ogre::Real d_time);
+  void zoom(const Ogre::Ray& cursor_ray);
   void stayOnSide(Ogre::Real target_y, Ogre::Real d_time, int side);
 };
 
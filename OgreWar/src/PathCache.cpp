@@ -0,0 +1,380 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "PathCache.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+
+using namespace Ogre;
+using namespace std;
+
+/// CONSTANTS
+
+const int PathCache::CLUSTER_SIZE = 16;
+
+/// UTILITY
+
+static const int STEP_COL[8] = { 1, -1, 0, 0, 1, 1, -1, -1 },
+                 STEP_ROW[8] = { 0, 0, 1, -1, 1, -1, 1, -1 };
+static const Real STEP_LENGTH[8] = { 1.0f, 1.0f, 1.0f, 1.0f,
+                        1.41421356f, 1.41421356f, 1.41421356f, 1.41421356f };
+
+typedef pair<Real, int> Entry;
+typedef priority_queue<Entry, vector<Entry>, greater<Entry> > OpenList;
+
+/// CREATION, DESTRUCTION
+
+PathCache::PathCache() :
+grid(NULL),
+revision(0),
+n_clusters(0),
+nodes(),
+cluster_nodes(),
+cache(),
+n_hits(0),
+n_misses(0)
+{
+}
+
+PathCache::~PathCache()
+{
+}
+
+void PathCache::update(const CostGrid& _grid)
+{
+  // Costs changed: the portals and every remembered route are out of date
+  if(grid == &_grid && revision == _grid.getRevision())
+    return;
+  grid = &_grid;
+  revision = _grid.getRevision();
+  build();
+}
+
+/// QUERY
+
+int PathCache::getCluster(const Vector3& position) const
+{
+  int col, row;
+  if(n_clusters == 0 || !grid->getCell(position.x, position.z, col, row))
+    return -1;
+  return getCluster(row * grid->getSize() + col);
+}
+
+bool PathCache::findCorridor(const Vector3& from, const Vector3& to,
+                             vector<unsigned char>& cells)
+{
+  int n = grid ? grid->getSize() : 0;
+  int from_col, from_row, to_col, to_row;
+  if(n_clusters == 0 || !grid->getCell(from.x, from.z, from_col, from_row)
+  || !grid->getCell(to.x, to.z, to_col, to_row)
+  || !grid->isPassable(from_col, from_row)
+  || !grid->isPassable(to_col, to_row))
+    return false;
+  int start = from_row * n + from_col, goal = to_row * n + to_col;
+
+  // Within a single cluster there is nothing to narrow down
+  int start_cluster = getCluster(start), goal_cluster = getCluster(goal);
+  if(start_cluster == goal_cluster)
+    return false;
+
+  // Find the ways out of the start cluster, and the ways into the goal
+  ClusterSearch from_search, to_search;
+  searchCluster(start_cluster, start, from_search);
+  searchCluster(goal_cluster, goal, to_search);
+
+  // Reuse the portals between these two clusters if both ends reach them
+  unsigned int key = start_cluster * n_clusters * n_clusters + goal_cluster;
+  map<unsigned int, vector<unsigned int> >::iterator cached = cache.find(key);
+  vector<unsigned int> portals;
+  if(cached != cache.end()
+  && from_search.cost[getLocal(start_cluster,
+                          nodes[cached->second.front()].cell)] != Math::POS_INFINITY
+  && to_search.cost[getLocal(goal_cluster,
+                          nodes[cached->second.back()].cell)] != Math::POS_INFINITY)
+  {
+    portals = cached->second;
+    n_hits++;
+  }
+  else
+  {
+    n_misses++;
+    if(!searchAbstract(from_search, to_search, portals))
+      return false;
+    cache[key] = portals;
+  }
+
+  // Open up every cluster on the way, and those either side for elbow room
+  vector<unsigned char> clusters(n_clusters * n_clusters, 0);
+  for(size_t p = 0; p < portals.size(); p++)
+  {
+    int x = nodes[portals[p]].cluster % n_clusters,
+        y = nodes[portals[p]].cluster / n_clusters;
+    for(int dy = -1; dy <= 1; dy++)
+      for(int dx = -1; dx <= 1; dx++)
+        if(x + dx >= 0 && x + dx < n_clusters && y + dy >= 0 && y + dy < n_clusters)
+          clusters[(y + dy) * n_clusters + x + dx] = 1;
+  }
+  cells.assign(n * n, 0);
+  for(int cell = 0; cell < n * n; cell++)
+    cells[cell] = clusters[getCluster(cell)];
+  return true;
+}
+
+unsigned long PathCache::getHitCount() const
+{
+  return n_hits;
+}
+
+unsigned long PathCache::getMissCount() const
+{
+  return n_misses;
+}
+
+/// SUBROUTINES
+
+void PathCache::build()
+{
+  nodes.clear();
+  cluster_nodes.clear();
+  cache.clear();
+  n_clusters = 0;
+  if(grid->isEmpty())
+    return;
+
+  // Portals wherever the border between a cluster and the one to its right or
+  // above is open
+  n_clusters = (grid->getSize() + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+  cluster_nodes.resize(n_clusters * n_clusters);
+  for(int y = 0; y < n_clusters; y++)
+    for(int x = 0; x < n_clusters; x++)
+    {
+      if(x + 1 < n_clusters)
+        addPortals(y * n_clusters + x, false);
+      if(y + 1 < n_clusters)
+        addPortals(y * n_clusters + x, true);
+    }
+
+  // Join up the portals within each cluster
+  for(int c = 0; c < n_clusters * n_clusters; c++)
+    connectCluster(c);
+}
+
+void PathCache::addPortals(int cluster, bool vertical)
+{
+  // Walk along the border with the next cluster right of or above this one
+  int n = grid->getSize();
+  int x0 = (cluster % n_clusters) * CLUSTER_SIZE,
+      y0 = (cluster / n_clusters) * CLUSTER_SIZE;
+  int length = min(CLUSTER_SIZE, n - (vertical ? x0 : y0));
+  int run_start = -1;
+  for(int i = 0; i <= length; i++)
+  {
+    int col_a = vertical ? x0 + i : x0 + CLUSTER_SIZE - 1,
+        row_a = vertical ? y0 + CLUSTER_SIZE - 1 : y0 + i,
+        col_b = vertical ? col_a : col_a + 1,
+        row_b = vertical ? row_a + 1 : row_a;
+    bool open = (i < length && grid->isPassable(col_a, row_a)
+                            && grid->isPassable(col_b, row_b));
+    if(open && run_start < 0)
+      run_start = i;
+    else if(!open && run_start >= 0)
+    {
+      // One portal in the middle of each open stretch
+      int middle = (run_start + i - 1) / 2;
+      col_a = vertical ? x0 + middle : x0 + CLUSTER_SIZE - 1;
+      row_a = vertical ? y0 + CLUSTER_SIZE - 1 : y0 + middle;
+      col_b = vertical ? col_a : col_a + 1;
+      row_b = vertical ? row_a + 1 : row_a;
+      unsigned int a = addNode(row_a * n + col_a),
+                   b = addNode(row_b * n + col_b);
+      Edge crossing;
+      crossing.cost = 0.5f * (grid->getCost(col_a, row_a)
+                              + grid->getCost(col_b, row_b));
+      crossing.to = b;
+      nodes[a].edges.push_back(crossing);
+      crossing.to = a;
+      nodes[b].edges.push_back(crossing);
+      run_start = -1;
+    }
+  }
+}
+
+unsigned int PathCache::addNode(int cell)
+{
+  Node node;
+  node.cell = cell;
+  node.cluster = getCluster(cell);
+  nodes.push_back(node);
+  cluster_nodes[node.cluster].push_back(nodes.size() - 1);
+  return nodes.size() - 1;
+}
+
+void PathCache::connectCluster(int cluster)
+{
+  // The cost of getting from each portal to every other, without leaving
+  const vector<unsigned int>& members = cluster_nodes[cluster];
+  ClusterSearch search;
+  for(size_t i = 0; i < members.size(); i++)
+  {
+    searchCluster(cluster, nodes[members[i]].cell, search);
+    for(size_t j = 0; j < members.size(); j++)
+    {
+      if(i == j)
+        continue;
+      int cell = nodes[members[j]].cell;
+      Real cost = search.cost[getLocal(cluster, cell)];
+      if(cost == Math::POS_INFINITY)
+        continue;
+      Edge inside;
+      inside.to = members[j];
+      inside.cost = cost;
+      nodes[members[i]].edges.push_back(inside);
+    }
+  }
+}
+
+int PathCache::getCluster(int cell) const
+{
+  int n = grid->getSize();
+  return (cell / n / CLUSTER_SIZE) * n_clusters + (cell % n) / CLUSTER_SIZE;
+}
+
+int PathCache::getLocal(int cluster, int cell) const
+{
+  int n = grid->getSize();
+  return (cell / n - (cluster / n_clusters) * CLUSTER_SIZE) * CLUSTER_SIZE
+         + cell % n - (cluster % n_clusters) * CLUSTER_SIZE;
+}
+
+Real PathCache::getDistance(int a, int b) const
+{
+  int n = grid->getSize();
+  return Math::Sqrt(Real(Math::Sqr(a % n - b % n) + Math::Sqr(a / n - b / n)));
+}
+
+void PathCache::searchCluster(int cluster, int start, ClusterSearch& out) const
+{
+  // Dijkstra from the start cell, confined to the cluster
+  int n = grid->getSize();
+  int x0 = (cluster % n_clusters) * CLUSTER_SIZE,
+      y0 = (cluster / n_clusters) * CLUSTER_SIZE,
+      x1 = min(x0 + CLUSTER_SIZE, n),
+      y1 = min(y0 + CLUSTER_SIZE, n);
+  out.cluster = cluster;
+  out.start = start;
+  out.cost.assign(CLUSTER_SIZE * CLUSTER_SIZE, Math::POS_INFINITY);
+
+  OpenList open;
+  out.cost[getLocal(cluster, start)] = 0.0f;
+  open.push(Entry(0.0f, start));
+  while(!open.empty())
+  {
+    Entry entry = open.top();
+    open.pop();
+    int col = entry.second % n, row = entry.second / n;
+    if(entry.first > out.cost[getLocal(cluster, entry.second)])
+      continue;
+    for(int s = 0; s < 8; s++)
+    {
+      int c = col + STEP_COL[s], r = row + STEP_ROW[s];
+      if(c < x0 || c >= x1 || r < y0 || r >= y1 || !grid->isPassable(c, r))
+        continue;
+      // Don't cut corners past impassable cells
+      if(s >= 4 && (!grid->isPassable(c, row) || !grid->isPassable(col, r)))
+        continue;
+      Real total = entry.first + 0.5f * (grid->getCost(col, row)
+                              + grid->getCost(c, r)) * STEP_LENGTH[s];
+      int local = getLocal(cluster, r * n + c);
+      if(total < out.cost[local])
+      {
+        out.cost[local] = total;
+        open.push(Entry(total, r * n + c));
+      }
+    }
+  }
+}
+
+bool PathCache::searchAbstract(const ClusterSearch& from,
+                               const ClusterSearch& to,
+                               vector<unsigned int>& out) const
+{
+  // A* over the portals, starting from every portal the start cluster
+  // reaches and aiming for the cell the 'to' search started from
+  vector<Real> cost(nodes.size(), Math::POS_INFINITY);
+  vector<int> came_from(nodes.size(), -1);
+  vector<bool> closed(nodes.size(), false);
+  OpenList open;
+  const vector<unsigned int>& exits = cluster_nodes[from.cluster];
+  for(size_t i = 0; i < exits.size(); i++)
+  {
+    int cell = nodes[exits[i]].cell;
+    Real exit_cost = from.cost[getLocal(from.cluster, cell)];
+    if(exit_cost == Math::POS_INFINITY)
+      continue;
+    cost[exits[i]] = exit_cost;
+    open.push(Entry(exit_cost + getDistance(cell, to.start), exits[i]));
+  }
+
+  Real best = Math::POS_INFINITY;
+  int best_node = -1;
+  while(!open.empty())
+  {
+    Entry entry = open.top();
+    open.pop();
+    if(entry.first >= best)
+      break;
+    if(closed[entry.second])
+      continue;
+    closed[entry.second] = true;
+    const Node& node = nodes[entry.second];
+
+    // Reaching the goal cluster: finish off with the goal search's cost
+    if(node.cluster == to.cluster)
+    {
+      Real total = cost[entry.second] + to.cost[getLocal(to.cluster, node.cell)];
+      if(total < best)
+      {
+        best = total;
+        best_node = entry.second;
+      }
+    }
+
+    for(size_t e = 0; e < node.edges.size(); e++)
+    {
+      const Edge& edge = node.edges[e];
+      Real total = cost[entry.second] + edge.cost;
+      if(total < cost[edge.to])
+      {
+        cost[edge.to] = total;
+        came_from[edge.to] = entry.second;
+        open.push(Entry(total + getDistance(nodes[edge.to].cell, to.start),
+                        edge.to));
+      }
+    }
+  }
+  if(best_node < 0)
+    return false;
+
+  out.clear();
+  for(int i = best_node; i >= 0; i = came_from[i])
+    out.push_back(i);
+  reverse(out.begin(), out.end());
+  return true;
+}
@@ -0,0 +1,99 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PATHCACHE_HPP_INCLUDED
+#define PATHCACHE_HPP_INCLUDED
+
+#include <map>
+#include <vector>
+
+#include <Ogre.h>
+
+#include "CostGrid.hpp"
+
+// Hierarchical routes over a CostGrid: the grid is cut into square clusters
+// joined by portals where their borders can be crossed, and routes are found
+// portal to portal. The clusters a route passes through form a corridor that
+// a FlowField can be confined to. The portal sequence between two clusters is
+// remembered, so later orders between the same regions skip the search.
+class PathCache
+{
+  /// CONSTANTS
+private:
+  static const int CLUSTER_SIZE;
+
+  /// NESTING
+private:
+  struct Edge
+  {
+    unsigned int to;
+    Ogre::Real cost;
+  };
+  struct Node
+  {
+    int cell;                         // Portal cell in the CostGrid
+    int cluster;
+    std::vector<Edge> edges;
+  };
+  // Cheapest known way from a start cell to each cell of one cluster
+  struct ClusterSearch
+  {
+    int cluster, start;
+    std::vector<Ogre::Real> cost;     // Indexed by position in the cluster
+  };
+
+  /// ATTRIBUTES
+private:
+  const CostGrid* grid;
+  unsigned int revision;              // Revision of the costs used
+  int n_clusters;                     // Clusters along each side
+  std::vector<Node> nodes;
+  std::vector< std::vector<unsigned int> > cluster_nodes;
+  std::map<unsigned int, std::vector<unsigned int> > cache;
+  unsigned long n_hits, n_misses;
+
+  /// METHODS
+public:
+  // creation, destruction
+  PathCache();
+  virtual ~PathCache();
+  void update(const CostGrid& _grid);
+  // query
+  int getCluster(const Ogre::Vector3& position) const;
+  bool findCorridor(const Ogre::Vector3& from, const Ogre::Vector3& to,
+                    std::vector<unsigned char>& cells);
+  unsigned long getHitCount() const;
+  unsigned long getMissCount() const;
+
+  /// SUBROUTINES
+private:
+  // abstract graph
+  void build();
+  void addPortals(int cluster, bool vertical);
+  unsigned int addNode(int cell);
+  void connectCluster(int cluster);
+  // search
+  int getCluster(int cell) const;
+  int getLocal(int cluster, int cell) const;
+  Ogre::Real getDistance(int a, int b) const;
+  void searchCluster(int cluster, int start, ClusterSearch& out) const;
+  bool searchAbstract(const ClusterSearch& from, const ClusterSearch& to,
+                      std::vector<unsigned int>& out) const;
+};
+
+#endif // PATHCACHE_HPP_INCLUDED
@@ -0,0 +1,232 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "RawHeightMap.hpp"
+
+#include <cmath>
+#include <cstring>
+
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+  #define WIN32_LEAN_AND_MEAN
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+using namespace Ogre;
+using namespace std;
+
+/// CREATION, DESTRUCTION
+
+RawHeightMap::RawHeightMap() :
+format(UINT16),
+side(0),
+bytes(NULL),
+n_bytes(0),
+modified(0)
+{
+}
+
+RawHeightMap::~RawHeightMap()
+{
+  close();
+}
+
+bool RawHeightMap::open(const String& path)
+{
+  close();
+
+  // The extension says how wide each sample is
+  if(StringUtil::endsWith(path, ".r16"))
+    format = UINT16;
+  else if(StringUtil::endsWith(path, ".r32"))
+    format = FLOAT32;
+  else
+    return false;
+
+  // Map the whole file read-only: the handles can go once the view is made
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if(file == INVALID_HANDLE_VALUE)
+    return false;
+  LARGE_INTEGER file_size;
+  FILETIME write_time;
+  if(GetFileTime(file, NULL, NULL, &write_time))
+    modified = ((unsigned long long)write_time.dwHighDateTime << 32)
+             | write_time.dwLowDateTime;
+  HANDLE mapping = NULL;
+  if(GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0)
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if(mapping)
+  {
+    bytes = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    n_bytes = bytes ? (size_t)file_size.QuadPart : 0;
+    CloseHandle(mapping);
+  }
+  CloseHandle(file);
+#else
+  int file = ::open(path.c_str(), O_RDONLY);
+  if(file < 0)
+    return false;
+  struct stat file_info;
+  if(fstat(file, &file_info) == 0 && file_info.st_size > 0)
+  {
+    modified = (unsigned long long)file_info.st_mtime;
+    void* view = mmap(NULL, file_info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    if(view != MAP_FAILED)
+    {
+      bytes = (const unsigned char*)view;
+      n_bytes = file_info.st_size;
+    }
+  }
+  ::close(file);
+#endif
+  if(!bytes)
+    return false;
+
+  // Only square maps, with at least one cell, are understood
+  size_t sample_size = (format == UINT16) ? sizeof(uint16) : sizeof(float);
+  side = (size_t)floor(sqrt(double(n_bytes / sample_size)) + 0.5);
+  if(side < 2 || side * side * sample_size != n_bytes)
+  {
+    close();
+    return false;
+  }
+  return true;
+}
+
+bool RawHeightMap::openResource(const String& name, const String& group)
+{
+  // Mapping needs a real file, so look for one in a plain directory
+  ResourceGroupManager& resources = ResourceGroupManager::getSingleton();
+  if(!resources.resourceExistsInAnyGroup(name))
+    return false;
+  String found = (group == ResourceGroupManager::AUTODETECT_RESOURCE_GROUP_NAME)
+               ? resources.findGroupContainingResource(name) : group;
+  FileInfoListPtr files = resources.findResourceFileInfo(found, name);
+  for(FileInfoList::iterator i = files->begin(); i != files->end(); i++)
+    if(i->archive->getType() == "FileSystem")
+      return open(i->archive->getName() + "/" + i->filename);
+  return false;
+}
+
+void RawHeightMap::close()
+{
+  if(bytes)
+  {
+#if OGRE_PLATFORM == OGRE_PLATFORM_WIN32
+    UnmapViewOfFile(bytes);
+#else
+    munmap((void*)bytes, n_bytes);
+#endif
+  }
+  bytes = NULL;
+  n_bytes = 0;
+  modified = 0;
+  side = 0;
+}
+
+/// QUERY
+
+bool RawHeightMap::isOpen() const
+{
+  return (bytes != NULL);
+}
+
+RawHeightMap::Format RawHeightMap::getFormat() const
+{
+  return format;
+}
+
+size_t RawHeightMap::getSide() const
+{
+  return side;
+}
+
+size_t RawHeightMap::getByteCount() const
+{
+  return n_bytes;
+}
+
+unsigned long long RawHeightMap::getModifiedTime() const
+{
+  return modified;
+}
+
+bool RawHeightMap::fitsPages(size_t page_size) const
+{
+  // Neighbouring pages share their edge samples
+  return (isOpen() && page_size > 1 && (side - 1) % (page_size - 1) == 0);
+}
+
+void RawHeightMap::readRect(long x, long y, size_t width, size_t height,
+                            float* out) const
+{
+  // (x, y) is the bottom-left sample, counting up from the bottom of the map
+  for(size_t j = 0; j < height; j++)
+    readRow(side - 1 - reflect(y + (long)j), x, width, out + j * width);
+}
+
+void RawHeightMap::readPage(long page_x, long page_y, size_t page_size,
+                            float* out) const
+{
+  // Centre the map's own pages on the TerrainGroup's page (0, 0)
+  long stride = (long)page_size - 1,
+       half_pages = (long)((side - 1) / stride) / 2;
+  readRect((page_x + half_pages) * stride, (page_y + half_pages) * stride,
+           page_size, page_size, out);
+}
+
+/// SUBROUTINES
+
+size_t RawHeightMap::reflect(long i) const
+{
+  // Bounce back and forth between the edges, without repeating them
+  long period = 2 * ((long)side - 1);
+  i %= period;
+  if(i < 0)
+    i += period;
+  return (i < (long)side) ? i : period - i;
+}
+
+void RawHeightMap::readRow(size_t row, long x, size_t width, float* out) const
+{
+  const uint16* words = (const uint16*)bytes + row * side;
+  const float* floats = (const float*)bytes + row * side;
+
+  // Straight out of the mapping when the row doesn't need mirroring
+  if(x >= 0 && (size_t)x + width <= side)
+  {
+    if(format == FLOAT32)
+      memcpy(out, floats + x, width * sizeof(float));
+    else
+      for(size_t i = 0; i < width; i++)
+        out[i] = words[x + i] * (1.0f / 65535.0f);
+    return;
+  }
+  for(size_t i = 0; i < width; i++)
+  {
+    size_t column = reflect(x + (long)i);
+    out[i] = (format == FLOAT32) ? floats[column]
+                                 : words[column] * (1.0f / 65535.0f);
+  }
+}
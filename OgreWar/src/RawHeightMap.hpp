@@ -0,0 +1,71 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef RAWHEIGHTMAP_HPP_INCLUDED
+#define RAWHEIGHTMAP_HPP_INCLUDED
+
+#include <Ogre.h>
+
+// A square RAW heightmap, mapped into memory rather than read in, so that
+// pages and smaller rectangles can be pulled out of it without decoding the
+// whole thing. Samples run from 0 to 1, top row first as in an image, stored
+// as 16-bit unsigned integers (.r16) or 32-bit floats (.r32) in the machine's
+// own byte order. Reads come back in terrain space, with rows ascending, and
+// mirror beyond the edges the way the PNG heightmap is tiled.
+class RawHeightMap
+{
+  /// NESTING
+public:
+  enum Format
+  {
+    UINT16,
+    FLOAT32
+  };
+
+  /// ATTRIBUTES
+private:
+  Format format;
+  size_t side;                  // Samples along each side
+  const unsigned char* bytes;   // Mapped file contents, NULL if not open
+  size_t n_bytes;
+  unsigned long long modified;  // Last write time, in the platform's own units
+
+  /// METHODS
+public:
+  // creation, destruction
+  RawHeightMap();
+  virtual ~RawHeightMap();
+  bool open(const Ogre::String& path);
+  bool openResource(const Ogre::String& name, const Ogre::String& group);
+  void close();
+  // query
+  bool isOpen() const;
+  Format getFormat() const;
+  size_t getSide() const;
+  size_t getByteCount() const;
+  unsigned long long getModifiedTime() const;
+  bool fitsPages(size_t page_size) const;
+  void readRect(long x, long y, size_t width, size_t height, float* out) const;
+  void readPage(long page_x, long page_y, size_t page_size, float* out) const;
+
+  /// SUBROUTINES
+private:
+  size_t reflect(long i) const;
+  void readRow(size_t row, long x, size_t width, float* out) const;
+};
+
+#endif // RAWHEIGHTMAP_HPP_INCLUDED
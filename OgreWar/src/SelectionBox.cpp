@@ -0,0 +1,61 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SelectionBox.hpp"
+
+using namespace Ogre;
+
+/// CREATION, DESTRUCTION
+
+SelectionBox::SelectionBox(const String& name) :
+ManualObject(name)
+{
+  // Draw straight to the screen, over everything else
+  setUseIdentityProjection(true);
+  setUseIdentityView(true);
+  setRenderQueueGroup(RENDER_QUEUE_OVERLAY);
+  setQueryFlags(0);
+  setCastShadows(false);
+
+  // Never culled: the box is always on screen when visible
+  AxisAlignedBox infinite;
+  infinite.setInfinite();
+  setBoundingBox(infinite);
+}
+
+SelectionBox::~SelectionBox()
+{
+}
+
+/// MODIFICATION
+
+void SelectionBox::setCorners(Vector2 top_left, Vector2 bottom_right)
+{
+  // Convert from [0, 1] screen coordinates, y down, to [-1, 1], y up
+  Real left = top_left.x * 2 - 1, right = bottom_right.x * 2 - 1,
+       top = 1 - top_left.y * 2, bottom = 1 - bottom_right.y * 2;
+
+  clear();
+  begin("BaseWhiteNoLighting", RenderOperation::OT_LINE_STRIP);
+    position(left, top, -1);
+    position(right, top, -1);
+    position(right, bottom, -1);
+    position(left, bottom, -1);
+    position(left, top, -1);
+  end();
+}
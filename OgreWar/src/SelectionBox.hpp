@@ -0,0 +1,36 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SELECTIONBOX_HPP_INCLUDED
+#define SELECTIONBOX_HPP_INCLUDED
+
+#include <OgreManualObject.h>
+
+// Screen-space rectangle drawn while the player drags out a selection
+class SelectionBox : public Ogre::ManualObject
+{
+  /// METHODS
+public:
+  // creation, destruction
+  SelectionBox(const Ogre::String& name);
+  virtual ~SelectionBox();
+  // modification
+  void setCorners(Ogre::Vector2 top_left, Ogre::Vector2 bottom_right);
+};
+
+#endif // SELECTIONBOX_HPP_INCLUDED
@@ -0,0 +1,67 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SimulationClock.hpp"
+
+using namespace Ogre;
+
+/// CREATION, DESTRUCTION
+
+SimulationClock::SimulationClock(Real _step, unsigned int _max_ticks) :
+step(_step),
+accumulator(0.0f),
+max_ticks(_max_ticks)
+{
+}
+
+SimulationClock::~SimulationClock()
+{
+}
+
+/// UPDATE
+
+unsigned int SimulationClock::advance(Real d_time)
+{
+  // Bank the frame time and count how many whole ticks it pays for
+  accumulator += d_time;
+  unsigned int ticks = 0;
+  while(accumulator >= step && ticks < max_ticks)
+  {
+    accumulator -= step;
+    ticks++;
+  }
+
+  // After a long hitch, drop the backlog rather than spiral into slowdown
+  if(accumulator >= step)
+    accumulator = 0.0f;
+
+  return ticks;
+}
+
+/// QUERY
+
+Real SimulationClock::getStep() const
+{
+  return step;
+}
+
+Real SimulationClock::getAlpha() const
+{
+  // How far the render frame lies between the last two ticks
+  return accumulator / step;
+}
@@ -0,0 +1,44 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SIMULATIONCLOCK_HPP_INCLUDED
+#define SIMULATIONCLOCK_HPP_INCLUDED
+
+#include <Ogre.h>
+
+class SimulationClock
+{
+  /// ATTRIBUTES
+private:
+  Ogre::Real step;            // Length of one simulation tick in seconds
+  Ogre::Real accumulator;     // Time not yet consumed by a tick
+  unsigned int max_ticks;     // Ticks allowed per frame before dropping time
+
+  /// METHODS
+public:
+  // creation, destruction
+  SimulationClock(Ogre::Real _step, unsigned int _max_ticks);
+  virtual ~SimulationClock();
+  // update
+  unsigned int advance(Ogre::Real d_time);
+  // query
+  Ogre::Real getStep() const;
+  Ogre::Real getAlpha() const;
+};
+
+#endif // SIMULATIONCLOCK_HPP_INCLUDED
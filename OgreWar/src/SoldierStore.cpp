@@ -0,0 +1,1341 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SoldierStore.hpp"
+
+#include <algorithm>
+
+#include "MovementKernel.hpp"
+
+using namespace Ogre;
+using namespace std;
+
+/// CONSTANTS
+
+const SoldierHandle SoldierStore::NONE = (SoldierHandle)-1;
+// low bits of a handle pick one of 16 million slots, high bits hold the
+// generation: a stale handle is only mistaken for a live one after its slot
+// has been reused 256 times
+const unsigned int SoldierStore::SLOT_BITS = 24;
+const SoldierHandle SoldierStore::SLOT_MASK = (1 << SLOT_BITS) - 1;
+const Real SoldierStore::WALK_SPEED = 15.0f;
+// bounding box around a Soldier's feet, used for picking
+const Real SoldierStore::RADIUS = 3.0f,
+           SoldierStore::HEIGHT = 10.0f;
+const size_t SoldierStore::TICK_GRAIN = 256;
+// switch from the flow field to a straight line this close to the end
+const Real SoldierStore::FLOW_ARRIVAL_CELLS = 1.5f;
+// personal space: less than the spacing of a Formation, so ranks don't jostle
+const Real SoldierStore::SEPARATION_RADIUS = 2.0f * RADIUS;
+const Real SoldierStore::SEPARATION_STIFFNESS = 0.5f;
+// nudges too small to notice are ignored, so that idle crowds settle down
+const Real SoldierStore::SEPARATION_MIN_PUSH = 0.05f;
+// idle Soldiers look for the nearest enemy this close, every so many ticks
+const Real SoldierStore::ACQUIRE_RANGE = 80.0f;
+const unsigned int SoldierStore::ACQUIRE_INTERVAL = 8;
+// close enough to strike, even with separation holding us apart
+const Real SoldierStore::MELEE_RANGE = 3.0f * RADIUS;
+const Real SoldierStore::MAX_HEALTH = 100.0f,
+           SoldierStore::ATTACK_DAMAGE = 10.0f,
+           SoldierStore::ATTACK_INTERVAL = 1.0f;
+
+/// UTILITY
+
+// Fill the hole at index i with the last element so the array stays packed
+template <typename T>
+static void removeAt(vector<T>& v, size_t i)
+{
+  std::swap(v[i], v.back());
+  v.pop_back();
+}
+
+// Hand an array's memory back, not just its contents
+template <typename T>
+static void release(vector<T>& v)
+{
+  vector<T>().swap(v);
+}
+
+/// CREATION, DESTRUCTION
+
+SoldierStore::SoldierStore() :
+scene(NULL),
+paths(NULL),
+slot_to_dense(),
+generations(),
+dense_to_handle(),
+free_slots(),
+n_active(0),
+state(), flags(),
+pos_x(), pos_y(), pos_z(),
+dir_x(), dir_z(),
+dest_x(), dest_z(),
+distance_left(),
+yaw(),
+prev_x(), prev_y(), prev_z(), prev_yaw(),
+waypoint_pool(),
+waypoints(),
+flow(),
+faction(), health(), target(), cooldown(),
+regiment(), regiments(),
+entities(), nodes(), animations(),
+entity_index(),
+arrivals(),
+push_x(), push_z(),
+grid(2.0f * RADIUS),
+grid_dirty(false),
+dormant_grid(2.0f * RADIUS),
+dormant_dirty(false),
+enemies(ACQUIRE_RANGE),
+n_ticks(0),
+hits()
+{
+}
+
+SoldierStore::~SoldierStore()
+{
+  clear();
+}
+
+void SoldierStore::setSceneManager(SceneManager* _scene)
+{
+  scene = _scene;
+}
+
+void SoldierStore::setFlowFields(FlowFieldCache* _paths)
+{
+  paths = _paths;
+}
+
+SoldierHandle SoldierStore::create(Vector3 position, unsigned char _faction)
+{
+  SoldierHandle handle = append(position.x, position.y, position.z, 0.0f,
+                                _faction);
+
+  // Create the scene objects unless we are running headless
+  if(scene)
+    attach(indexOf(handle));
+
+  // Dense indices in the grid are only valid until the next change
+  grid_dirty = true;
+
+  return handle;
+}
+
+void SoldierStore::spawnRegiment(size_t n, Vector3 origin,
+                                 const Formation& formation,
+                                 const HeightField& terrain,
+                                 unsigned char _faction,
+                                 SoldierHandleList* out)
+{
+  if(n == 0)
+    return;
+
+  // Lay out the whole regiment, then snap it to the ground in one batch
+  vector<Real> x(n), y(n, origin.y), z(n);
+  formation.getSlots(n, origin, Vector3::NEGATIVE_UNIT_Z, &x[0], &z[0]);
+  if(!terrain.isEmpty())
+    terrain.sampleHeights(&x[0], &z[0], &y[0], n);
+
+  // Grow every array once rather than once per Soldier
+  reserve(size() + n);
+  if(out)
+    out->reserve(out->size() + n);
+  Real facing = Math::ATan2(1.0f, 0.0f).valueRadians();
+  unsigned int r = regiments.size();
+  regiments.push_back(Regiment());
+  regiments[r].members.reserve(n);
+  regiments[r].faction = _faction;
+  regiments[r].asleep = false;
+  size_t first = n_active;
+  for(size_t i = 0; i < n; i++)
+  {
+    SoldierHandle handle = append(x[i], y[i], z[i], facing, _faction);
+    regiment[indexOf(handle)] = r;
+    regiments[r].members.push_back(handle);
+    if(out)
+      out->push_back(handle);
+  }
+  measureRegiment(regiments[r]);
+
+  // Create the scene objects unless we are running headless
+  if(scene)
+    for(size_t i = first; i < n_active; i++)
+      attach(i);
+
+  grid_dirty = true;
+}
+
+void SoldierStore::reserve(size_t n)
+{
+  // Room for a whole battle up front, so that reinforcements don't reallocate
+  slot_to_dense.reserve(n);
+  generations.reserve(n);
+  dense_to_handle.reserve(n);
+  state.reserve(n);
+  flags.reserve(n);
+  pos_x.reserve(n);
+  pos_y.reserve(n);
+  pos_z.reserve(n);
+  dir_x.reserve(n);
+  dir_z.reserve(n);
+  dest_x.reserve(n);
+  dest_z.reserve(n);
+  distance_left.reserve(n);
+  yaw.reserve(n);
+  prev_x.reserve(n);
+  prev_y.reserve(n);
+  prev_z.reserve(n);
+  prev_yaw.reserve(n);
+  waypoints.reserve(n);
+  flow.reserve(n);
+  faction.reserve(n);
+  health.reserve(n);
+  target.reserve(n);
+  cooldown.reserve(n);
+  regiment.reserve(n);
+  entities.reserve(n);
+  nodes.reserve(n);
+  animations.reserve(n);
+}
+
+void SoldierStore::destroy(SoldierHandle handle)
+{
+  size_t i = indexOf(handle);
+  if(i == NONE)
+    return;
+  detach(i);
+
+  // Leave the Regiment, which stays around even when empty
+  if(regiment[i] != NONE)
+  {
+    SoldierHandleList& members = regiments[regiment[i]].members;
+    *std::find(members.begin(), members.end(), handle) = members.back();
+    members.pop_back();
+  }
+
+  // Keep the awake Soldiers packed at the front
+  if(i < n_active)
+  {
+    n_active--;
+    swapSoldiers(i, n_active);
+    i = n_active;
+  }
+
+  // Move the last Soldier into the hole and update its slot
+  SoldierHandle moved = dense_to_handle.back();
+  slot_to_dense[moved & SLOT_MASK] = i;
+  removeAt(dense_to_handle, i);
+  removeAt(state, i);
+  removeAt(flags, i);
+  removeAt(pos_x, i);
+  removeAt(pos_y, i);
+  removeAt(pos_z, i);
+  removeAt(dir_x, i);
+  removeAt(dir_z, i);
+  removeAt(dest_x, i);
+  removeAt(dest_z, i);
+  removeAt(distance_left, i);
+  removeAt(yaw, i);
+  removeAt(prev_x, i);
+  removeAt(prev_y, i);
+  removeAt(prev_z, i);
+  removeAt(prev_yaw, i);
+  clearWaypoints(i);
+  removeAt(waypoints, i);
+  removeAt(flow, i);
+  removeAt(faction, i);
+  removeAt(health, i);
+  removeAt(target, i);
+  removeAt(cooldown, i);
+  removeAt(regiment, i);
+  removeAt(entities, i);
+  removeAt(nodes, i);
+  removeAt(animations, i);
+
+  // The destroyed Soldier's slot can now be reused, but not its handle
+  size_t slot = handle & SLOT_MASK;
+  slot_to_dense[slot] = NONE;
+  generations[slot]++;
+  free_slots.push_back(slot);
+  grid_dirty = dormant_dirty = true;
+}
+
+void SoldierStore::clear()
+{
+  // Everybody goes at once: tear down the scene objects and let go of the
+  // fields, then hand all the memory back in bulk. Slots are kept so that
+  // handles from this battle stay stale in the next.
+  for(size_t i = 0; i < dense_to_handle.size(); i++)
+  {
+    detach(i);
+    clearWaypoints(i);
+    size_t slot = dense_to_handle[i] & SLOT_MASK;
+    slot_to_dense[slot] = NONE;
+    generations[slot]++;
+    free_slots.push_back(slot);
+  }
+  n_active = 0;
+  release(dense_to_handle);
+  release(state);
+  release(flags);
+  release(pos_x);
+  release(pos_y);
+  release(pos_z);
+  release(dir_x);
+  release(dir_z);
+  release(dest_x);
+  release(dest_z);
+  release(distance_left);
+  release(yaw);
+  release(prev_x);
+  release(prev_y);
+  release(prev_z);
+  release(prev_yaw);
+  release(waypoints);
+  release(flow);
+  release(faction);
+  release(health);
+  release(target);
+  release(cooldown);
+  release(regiment);
+  release(entities);
+  release(nodes);
+  release(animations);
+  release(regiments);
+  release(arrivals);
+  release(push_x);
+  release(push_z);
+  release(hits);
+  waypoint_pool.release();
+  grid.clear();
+  dormant_grid.clear();
+  grid_dirty = dormant_dirty = false;
+}
+
+/// UPDATE
+
+void SoldierStore::tick(Real d_time, const HeightField& terrain,
+                        JobSystem& jobs)
+{
+  // Remember where everyone was so that frames can blend towards the new tick.
+  // Sleeping Soldiers stand still, so theirs are already the same.
+  std::copy(pos_x.begin(), pos_x.begin() + n_active, prev_x.begin());
+  std::copy(pos_y.begin(), pos_y.begin() + n_active, prev_y.begin());
+  std::copy(pos_z.begin(), pos_z.begin() + n_active, prev_z.begin());
+  std::copy(yaw.begin(), yaw.begin() + n_active, prev_yaw.begin());
+
+  // Neighbours are found through the grid, which must match the dense indices
+  if(grid_dirty)
+    updateGrid();
+
+  // Only awake Soldiers are simulated one by one
+  updateRegiments();
+  if(grid_dirty)
+    updateGrid();
+
+  // Each chunk lists its arrivals in its own part of the scratch array
+  arrivals.resize(n_active);
+  push_x.resize(n_active);
+  push_z.resize(n_active);
+  hits.resize(n_active);
+
+  // Sort everybody by faction once, so that finding an enemy is a grid lookup
+  if(n_active == 0)
+    enemies.build(NULL, NULL, NULL, 0);
+  else
+    enemies.build(&faction[0], &pos_x[0], &pos_z[0], n_active);
+
+  // Soldiers only touch their own data, so chunks can run on any thread. The
+  // scene graph is left alone until applyToScene, back on the render thread.
+  TickJob job;
+  job.store = this;
+  job.d_time = d_time;
+  job.terrain = &terrain;
+  jobs.parallelFor(job, n_active, TICK_GRAIN);
+  n_ticks++;
+
+  // Blows land all at once, then the dead are removed
+  resolveHits();
+
+  // Re-sort everyone into the grid at their new positions
+  updateGrid();
+}
+
+void SoldierStore::TickJob::run(size_t begin, size_t end)
+{
+  store->tickRange(begin, end, d_time, *terrain);
+}
+
+void SoldierStore::tickRange(size_t begin, size_t end, Real d_time,
+                              const HeightField& terrain)
+{
+  if(begin == end)
+    return;
+
+  // Move an amount dependent on the length of the tick
+  Real move = WALK_SPEED * d_time;
+
+  for(size_t i = begin; i < end; i++)
+  {
+    // Soldiers that moved last tick need one more frame to settle
+    if(flags[i] & MOVED)
+      flags[i] = (flags[i] & ~MOVED) | SETTLING;
+    else
+      flags[i] &= ~SETTLING;
+
+    // Orders come first: otherwise, idle Soldiers look for a fight
+    hits[i] = NONE;
+    if(state[i] != WALKING)
+    {
+      if(!waypoints[i].isEmpty())
+      {
+        target[i] = NONE;
+        nextWaypoint(i);
+      }
+      else
+        engage(i, d_time);
+    }
+
+    if(state[i] == WALKING)
+    {
+      flags[i] |= MOVED;
+      if(flow[i] != FlowFieldCache::NONE)
+        steer(i);
+    }
+  }
+
+  // Move everybody in one vectorised sweep: idle Soldiers have no direction
+  // and an infinite distance left, so they neither move nor arrive
+  unsigned int* arrived = &arrivals[begin];
+  size_t n_arrived = MovementKernel::advance(end - begin, move,
+                        &pos_x[begin], &pos_z[begin],
+                        &dir_x[begin], &dir_z[begin],
+                        &dest_x[begin], &dest_z[begin],
+                        &distance_left[begin], arrived);
+
+  // Start towards new location if there is one, or wait to strike
+  for(size_t a = 0; a < n_arrived; a++)
+  {
+    size_t i = begin + arrived[a];
+    if(state[i] == ENGAGING)
+    {
+      dir_x[i] = dir_z[i] = 0.0f;
+      distance_left[i] = Math::POS_INFINITY;
+    }
+    else
+      nextWaypoint(i);
+  }
+
+  // Step out of each other's way, but not off a cliff
+  separate(begin, end, move);
+  for(size_t i = begin; i < end; i++)
+  {
+    if(push_x[i] == 0.0f && push_z[i] == 0.0f)
+      continue;
+    if(paths && !paths->getCostGrid().isPassableAt(pos_x[i] + push_x[i],
+                                                   pos_z[i] + push_z[i]))
+      continue;
+    pos_x[i] += push_x[i];
+    pos_z[i] += push_z[i];
+    flags[i] |= MOVED;
+
+    // Walking in a straight line: aim at the destination again
+    if(state[i] == WALKING && flow[i] == FlowFieldCache::NONE)
+    {
+      Real dx = dest_x[i] - pos_x[i],
+           dz = dest_z[i] - pos_z[i];
+      Real distance = Math::Sqrt(dx * dx + dz * dz);
+      if(distance > 0.0f)
+      {
+        dir_x[i] = dx / distance;
+        dir_z[i] = dz / distance;
+      }
+      distance_left[i] = distance;
+    }
+  }
+
+  // Stay above terrain: snap the whole range in one batch
+  terrain.sampleHeights(&pos_x[begin], &pos_z[begin], &pos_y[begin],
+                        end - begin);
+}
+
+void SoldierStore::applyToScene(Real alpha, Real d_time)
+{
+  for(size_t i = 0; i < nodes.size(); i++)
+  {
+    unsigned char changes = flags[i];
+    flags[i] &= ~STATE_CHANGED;
+
+    // Headless Soldiers have nothing to update
+    if(!nodes[i])
+      continue;
+
+    // Place and orient the node between the previous and current tick
+    if(changes & (MOVED | SETTLING))
+    {
+      Real turn = yaw[i] - prev_yaw[i];
+      if(turn > Math::PI)
+        turn -= Math::TWO_PI;
+      else if(turn < -Math::PI)
+        turn += Math::TWO_PI;
+      nodes[i]->setPosition(prev_x[i] + (pos_x[i] - prev_x[i]) * alpha,
+                            prev_y[i] + (pos_y[i] - prev_y[i]) * alpha,
+                            prev_z[i] + (pos_z[i] - prev_z[i]) * alpha);
+      nodes[i]->setOrientation(Quaternion(Radian(prev_yaw[i] + turn * alpha),
+                                          Vector3::UNIT_Y));
+    }
+
+    // Switch animation when we start or stop walking, or start fighting
+    if(changes & STATE_CHANGED)
+    {
+      const char* animation = "Idle";
+      if(state[i] == WALKING || state[i] == ENGAGING)
+        animation = "Walk";
+      else if(state[i] == FIGHTING)
+        animation = "Shoot";
+      animations[i]->setEnabled(false);
+      animations[i] = entities[i]->getAnimationState(animation);
+      animations[i]->setLoop(true);
+      animations[i]->setEnabled(true);
+    }
+
+    // Animate an amount dependent on the elapsed time since the last frame
+    animations[i]->addTime(d_time);
+  }
+}
+
+/// CONTROL
+
+void SoldierStore::setSelected(SoldierHandle handle, bool _selected)
+{
+  size_t i = indexOf(handle);
+  if(i != NONE)
+    setSelectedAt(i, _selected);
+}
+
+void SoldierStore::deselectAll()
+{
+  for(size_t i = 0; i < flags.size(); i++)
+    if(flags[i] & SELECTED)
+      setSelectedAt(i, false);
+}
+
+void SoldierStore::selectInside(const Vector3 corners[4])
+{
+  if(grid_dirty)
+    updateGrid();
+  if(dormant_dirty)
+    updateDormantGrid();
+
+  // Gather candidates from the cells under the footprint's bounding box
+  Real min_x = corners[0].x, max_x = corners[0].x,
+       min_z = corners[0].z, max_z = corners[0].z;
+  for(int c = 1; c < 4; c++)
+  {
+    min_x = std::min(min_x, corners[c].x);
+    max_x = std::max(max_x, corners[c].x);
+    min_z = std::min(min_z, corners[c].z);
+    max_z = std::max(max_z, corners[c].z);
+  }
+  vector<unsigned int> candidates;
+  grid.queryRect(min_x, min_z, max_x, max_z, candidates);
+  size_t n_awake = candidates.size();
+  dormant_grid.queryRect(min_x, min_z, max_x, max_z, candidates);
+  for(size_t k = n_awake; k < candidates.size(); k++)
+    candidates[k] += n_active;
+
+  // The footprint is convex: inside means on the same side of every edge
+  for(size_t k = 0; k < candidates.size(); k++)
+  {
+    size_t i = candidates[k];
+    int sides = 0;
+    for(int c = 0; c < 4; c++)
+    {
+      const Vector3& a = corners[c];
+      const Vector3& b = corners[(c + 1) % 4];
+      Real cross = (b.x - a.x) * (pos_z[i] - a.z) - (b.z - a.z) * (pos_x[i] - a.x);
+      sides += (cross > 0.0f) ? 1 : ((cross < 0.0f) ? -1 : 0);
+    }
+    if(sides == 4 || sides == -4)
+      setSelectedAt(i, true);
+  }
+}
+
+void SoldierStore::addWaypoint(SoldierHandle handle, Vector3 destination)
+{
+  if(!isValid(handle))
+    return;
+
+  // Orders are carried out Soldier by Soldier
+  if(regiment[indexOf(handle)] != NONE)
+    wake(regiment[indexOf(handle)]);
+
+  unsigned int field = paths ? paths->acquire(destination) : FlowFieldCache::NONE;
+  if(paths)
+    paths->retain(field);
+  waypoint_pool.push(waypoints[indexOf(handle)],
+                     Waypoint(destination, field));
+}
+
+void SoldierStore::addWaypointToSelected(Vector3 destination)
+{
+  // Everybody given the same order follows the same field
+  wakeSelected();
+  unsigned int field = paths ? paths->acquire(destination) : FlowFieldCache::NONE;
+  Waypoint new_waypoint(destination, field);
+  for(size_t i = 0; i < flags.size(); i++)
+    if(flags[i] & SELECTED)
+    {
+      if(paths)
+        paths->retain(field);
+      waypoint_pool.push(waypoints[i], new_waypoint);
+    }
+}
+
+void SoldierStore::addFormationToSelected(Vector3 destination,
+                                          const Formation& formation)
+{
+  // Gather everybody given the order, and where they stand now
+  wakeSelected();
+  vector<unsigned int> selected;
+  for(size_t i = 0; i < flags.size(); i++)
+    if(flags[i] & SELECTED)
+      selected.push_back(i);
+  size_t n = selected.size();
+  if(n == 0)
+    return;
+  vector<Real> from_x(n), from_z(n), slot_x(n), slot_z(n);
+  vector<unsigned int> slot_of(n);
+  Vector3 centre = Vector3::ZERO;
+  for(size_t k = 0; k < n; k++)
+  {
+    from_x[k] = pos_x[selected[k]];
+    from_z[k] = pos_z[selected[k]];
+    centre.x += from_x[k];
+    centre.z += from_z[k];
+  }
+  centre /= Real(n);
+
+  // Face the way we are marching, and lay out the slots all in one pass
+  Vector3 facing = destination - centre;
+  formation.getSlots(n, destination, facing, &slot_x[0], &slot_z[0]);
+  formation.assignSlots(n, facing, &from_x[0], &from_z[0],
+                        &slot_x[0], &slot_z[0], &slot_of[0]);
+
+  // Everybody follows the field to the centre, then peels off to their slot.
+  // From far away, the field only covers the route from where we stand.
+  unsigned int field = paths ? paths->acquire(destination, &centre)
+                             : FlowFieldCache::NONE;
+  for(size_t k = 0; k < n; k++)
+  {
+    if(paths)
+      paths->retain(field);
+    Vector3 slot(slot_x[slot_of[k]], destination.y, slot_z[slot_of[k]]);
+    waypoint_pool.push(waypoints[selected[k]], Waypoint(slot, field));
+  }
+}
+
+/// QUERY
+
+size_t SoldierStore::size() const
+{
+  return dense_to_handle.size();
+}
+
+size_t SoldierStore::getActiveCount() const
+{
+  return n_active;
+}
+
+bool SoldierStore::isValid(SoldierHandle handle) const
+{
+  return (indexOf(handle) != NONE);
+}
+
+bool SoldierStore::isSelected(SoldierHandle handle) const
+{
+  size_t i = indexOf(handle);
+  return (i != NONE && (flags[i] & SELECTED));
+}
+
+Vector3 SoldierStore::getPosition(SoldierHandle handle) const
+{
+  size_t i = indexOf(handle);
+  if(i == NONE)
+    return Vector3::ZERO;
+
+  return Vector3(pos_x[i], pos_y[i], pos_z[i]);
+}
+
+unsigned char SoldierStore::getFaction(SoldierHandle handle) const
+{
+  size_t i = indexOf(handle);
+  return (i == NONE) ? 0 : faction[i];
+}
+
+Real SoldierStore::getHealth(SoldierHandle handle) const
+{
+  size_t i = indexOf(handle);
+  return (i == NONE) ? 0.0f : health[i];
+}
+
+bool SoldierStore::getRegiment(SoldierHandle handle, Vector3& centre,
+                               Real& heading, size_t& strength) const
+{
+  size_t i = indexOf(handle);
+  if(i == NONE || regiment[i] == NONE)
+    return false;
+
+  // Sleeping Regiments are already summed up
+  Regiment aggregate = regiments[regiment[i]];
+  if(!aggregate.asleep)
+    measureRegiment(aggregate);
+  centre = aggregate.centre;
+  heading = aggregate.heading;
+  strength = aggregate.members.size();
+  return true;
+}
+
+SoldierHandle SoldierStore::find(MovableObject* movable) const
+{
+  SoldierEntityMap::const_iterator i = entity_index.find(movable);
+  return (i == entity_index.end()) ? NONE : i->second;
+}
+
+SoldierHandle SoldierStore::pick(const Ray& ray)
+{
+  if(grid_dirty)
+    updateGrid();
+  if(dormant_dirty)
+    updateDormantGrid();
+
+  // Awake and sleeping Soldiers are sorted into separate grids
+  size_t best = NONE;
+  Real best_t = Math::POS_INFINITY;
+  pickIn(grid, 0, ray, best, best_t);
+  pickIn(dormant_grid, n_active, ray, best, best_t);
+
+  return (best == NONE) ? NONE : dense_to_handle[best];
+}
+
+void SoldierStore::getSelected(SoldierHandleList& out) const
+{
+  for(size_t i = 0; i < flags.size(); i++)
+    if(flags[i] & SELECTED)
+      out.push_back(dense_to_handle[i]);
+}
+
+void SoldierStore::getPositions(vector<Vector3>& out, bool awake) const
+{
+  // Awake Soldiers are the first n_active, sleeping ones the rest
+  size_t begin = awake ? 0 : n_active,
+         end = awake ? n_active : pos_x.size();
+  out.resize(end - begin);
+  for(size_t i = begin; i < end; i++)
+    out[i - begin] = Vector3(pos_x[i], pos_y[i], pos_z[i]);
+}
+
+/// SUBROUTINES
+
+size_t SoldierStore::indexOf(SoldierHandle handle) const
+{
+  // A stale handle names a freed slot, or one reused by a later generation
+  size_t slot = handle & SLOT_MASK;
+  if(slot >= slot_to_dense.size()
+  || generations[slot] != (handle >> SLOT_BITS))
+    return NONE;
+  return slot_to_dense[slot];
+}
+
+SoldierHandle SoldierStore::append(Real x, Real y, Real z, Real _yaw,
+                                   unsigned char _faction)
+{
+  // Recycle a free slot if possible so that slots stay compact
+  size_t slot;
+  if(free_slots.empty())
+  {
+    slot = slot_to_dense.size();
+    slot_to_dense.push_back(NONE);
+    generations.push_back(0);
+  }
+  else
+  {
+    slot = free_slots.front();
+    free_slots.pop_front();
+  }
+  SoldierHandle handle = ((SoldierHandle)generations[slot] << SLOT_BITS) | slot;
+
+  // New Soldiers are appended to the packed arrays
+  size_t i = dense_to_handle.size();
+  slot_to_dense[slot] = i;
+  dense_to_handle.push_back(handle);
+  state.push_back(IDLING);
+  flags.push_back(MOVED);
+  pos_x.push_back(x);
+  pos_y.push_back(y);
+  pos_z.push_back(z);
+  dir_x.push_back(0.0f);
+  dir_z.push_back(0.0f);
+  dest_x.push_back(x);
+  dest_z.push_back(z);
+  distance_left.push_back(Math::POS_INFINITY);
+  yaw.push_back(_yaw);
+  prev_x.push_back(x);
+  prev_y.push_back(y);
+  prev_z.push_back(z);
+  prev_yaw.push_back(_yaw);
+  waypoints.push_back(WaypointPool::Queue());
+  flow.push_back(FlowFieldCache::NONE);
+  faction.push_back(_faction);
+  health.push_back(MAX_HEALTH);
+  target.push_back(NONE);
+  cooldown.push_back(0.0f);
+  regiment.push_back(NONE);
+  entities.push_back(NULL);
+  nodes.push_back(NULL);
+  animations.push_back(NULL);
+
+  // Newcomers start awake, ahead of any sleeping Soldiers
+  if(i != n_active)
+  {
+    swapSoldiers(i, n_active);
+    dormant_dirty = true;
+  }
+  n_active++;
+
+  return handle;
+}
+
+void SoldierStore::attach(size_t i)
+{
+  // Create the Entity, letting the scene manager name it
+  entities[i] = scene->createEntity("robot.mesh");
+
+  // Map Entity* (MovableObject*) to the Soldier's handle
+  entity_index[entities[i]] = dense_to_handle[i];
+
+  // Create an anonymous scene Node facing the Soldier's direction
+  nodes[i] = scene->getRootSceneNode()->createChildSceneNode(
+                                  Vector3(pos_x[i], pos_y[i], pos_z[i]),
+                                  Quaternion(Radian(yaw[i]), Vector3::UNIT_Y));
+
+  // Attach Entity to Node
+  nodes[i]->attachObject(entities[i]);
+  nodes[i]->setScale(0.1f, 0.1f, 0.1f);
+
+  // Set to the idle animation and loop
+  animations[i] = entities[i]->getAnimationState("Idle");
+  animations[i]->setLoop(true);
+  animations[i]->setEnabled(true);
+}
+
+void SoldierStore::detach(size_t i)
+{
+  if(entities[i])
+  {
+    entity_index.erase(entities[i]);
+    scene->destroyEntity(entities[i]);
+  }
+  if(nodes[i])
+    scene->destroySceneNode(nodes[i]);
+  entities[i] = NULL;
+  nodes[i] = NULL;
+  animations[i] = NULL;
+}
+
+void SoldierStore::nextWaypoint(size_t i)
+{
+  // Let go of the field we were following
+  if(paths)
+    paths->release(flow[i]);
+  flow[i] = FlowFieldCache::NONE;
+
+  if(waypoints[i].isEmpty())
+  {
+    // We are now idling again
+    if(state[i] != IDLING)
+      flags[i] |= STATE_CHANGED;
+    state[i] = IDLING;
+    dir_x[i] = dir_z[i] = 0.0f;
+    distance_left[i] = Math::POS_INFINITY;
+  }
+  else
+  {
+    // get the next destination from the queue
+    Vector3 const& destination = waypoints[i].front().getPosition();
+    dest_x[i] = destination.x;
+    dest_z[i] = destination.z;
+    flow[i] = waypoints[i].front().getField();
+    waypoint_pool.pop(waypoints[i]);
+
+    // turn towards the new destination, ignoring pitch difference
+    Vector3 direction(dest_x[i] - pos_x[i], 0.0f, dest_z[i] - pos_z[i]);
+    distance_left[i] = direction.normalise();
+    dir_x[i] = direction.x;
+    dir_z[i] = direction.z;
+
+    // the mesh faces along its local x axis
+    if(distance_left[i] > 0.0f)
+      yaw[i] = Math::ATan2(-direction.z, direction.x).valueRadians();
+
+    // We are now moving again
+    if(state[i] != WALKING)
+      flags[i] |= STATE_CHANGED;
+    state[i] = WALKING;
+  }
+}
+
+void SoldierStore::clearWaypoints(size_t i)
+{
+  // Queued orders and the current one all hold on to their fields
+  if(paths)
+  {
+    paths->release(flow[i]);
+    for(; !waypoints[i].isEmpty(); waypoint_pool.pop(waypoints[i]))
+      paths->release(waypoints[i].front().getField());
+  }
+  flow[i] = FlowFieldCache::NONE;
+  waypoint_pool.clear(waypoints[i]);
+}
+
+void SoldierStore::steer(size_t i)
+{
+  // Distance as the crow flies: the kernel snaps to the destination on arrival
+  Real dx = dest_x[i] - pos_x[i],
+       dz = dest_z[i] - pos_z[i];
+  Real distance = Math::Sqrt(dx * dx + dz * dz);
+  distance_left[i] = distance;
+
+  // Follow the field around obstacles, then walk straight in at the end
+  const CostGrid& grid = paths->getCostGrid();
+  Real fx, fz;
+  if(distance < grid.getCellSize() * FLOW_ARRIVAL_CELLS
+  || !paths->getField(flow[i]).getDirection(grid, pos_x[i], pos_z[i], fx, fz))
+  {
+    if(distance <= 0.0f)
+      return;
+    fx = dx / distance;
+    fz = dz / distance;
+  }
+
+  // the mesh faces along its local x axis
+  if(fx != dir_x[i] || fz != dir_z[i])
+  {
+    dir_x[i] = fx;
+    dir_z[i] = fz;
+    yaw[i] = Math::ATan2(-fz, fx).valueRadians();
+  }
+}
+
+void SoldierStore::engage(size_t i, Real d_time)
+{
+  cooldown[i] = std::max(0.0f, cooldown[i] - d_time);
+
+  // Keep the same enemy between searches, unless they fell or fell asleep.
+  // Searches are staggered by slot so only a few look around on any one tick.
+  size_t t = indexOf(target[i]);
+  if(t >= n_active || faction[t] == faction[i])
+    t = NONE;
+  bool lost = (target[i] != NONE && t == NONE);
+  if(lost || (n_ticks + dense_to_handle[i]) % ACQUIRE_INTERVAL == 0)
+  {
+    // Other chunks are moving their Soldiers: use the start of the tick
+    t = enemies.findNearestEnemy(faction[i], prev_x[i], prev_z[i],
+                                 ACQUIRE_RANGE);
+    if(t == FactionIndex::NONE)
+      t = NONE;
+    target[i] = (t == NONE) ? NONE : dense_to_handle[t];
+  }
+
+  // Nobody to fight: stand down
+  if(t == NONE)
+  {
+    if(state[i] != IDLING)
+      nextWaypoint(i);
+    return;
+  }
+
+  // Face the enemy, the mesh facing along its local x axis
+  Real dx = prev_x[t] - pos_x[i],
+       dz = prev_z[t] - pos_z[i];
+  Real distance = Math::Sqrt(dx * dx + dz * dz);
+  if(distance > 0.0f)
+  {
+    dx /= distance;
+    dz /= distance;
+    yaw[i] = Math::ATan2(-dz, dx).valueRadians();
+  }
+  unsigned char new_state;
+  if(distance > MELEE_RANGE)
+  {
+    // Close in, stopping well within reach
+    new_state = ENGAGING;
+    Real stop = MELEE_RANGE * 0.5f;
+    dir_x[i] = dx;
+    dir_z[i] = dz;
+    dest_x[i] = prev_x[t] - dx * stop;
+    dest_z[i] = prev_z[t] - dz * stop;
+    distance_left[i] = distance - stop;
+    flags[i] |= MOVED;
+  }
+  else
+  {
+    // Stand and strike whenever ready
+    new_state = FIGHTING;
+    dir_x[i] = dir_z[i] = 0.0f;
+    distance_left[i] = Math::POS_INFINITY;
+    if(cooldown[i] <= 0.0f)
+    {
+      hits[i] = t;
+      cooldown[i] = ATTACK_INTERVAL;
+    }
+    if(yaw[i] != prev_yaw[i])
+      flags[i] |= MOVED;
+  }
+  if(state[i] != new_state)
+    flags[i] |= STATE_CHANGED;
+  state[i] = new_state;
+}
+
+void SoldierStore::resolveHits()
+{
+  // Everybody strikes before anybody falls, so chunk order makes no difference
+  for(size_t i = 0; i < hits.size(); i++)
+    if(hits[i] != NONE)
+      health[hits[i]] -= ATTACK_DAMAGE;
+
+  // Only the awake can be struck. Going backwards, the Soldier swapped into a
+  // hole has already been seen.
+  for(size_t i = n_active; i > 0; i--)
+    if(health[i - 1] <= 0.0f)
+      destroy(dense_to_handle[i - 1]);
+}
+
+void SoldierStore::updateRegiments()
+{
+  // Decide against the grid as it stands, before anybody changes places
+  vector<unsigned int> waking, sleeping;
+  for(unsigned int r = 0; r < regiments.size(); r++)
+  {
+    Regiment& current = regiments[r];
+    if(current.members.empty())
+      continue;
+    if(current.asleep)
+    {
+      if(isInContact(r))
+        waking.push_back(r);
+    }
+    else if(isRestful(current))
+    {
+      measureRegiment(current);
+      if(!isInContact(r))
+        sleeping.push_back(r);
+    }
+  }
+
+  for(size_t k = 0; k < waking.size(); k++)
+    wake(waking[k]);
+  for(size_t k = 0; k < sleeping.size(); k++)
+    sleep(sleeping[k]);
+}
+
+void SoldierStore::measureRegiment(Regiment& r) const
+{
+  // Centre of mass, average facing and the circle around everybody
+  r.centre = Vector3::ZERO;
+  Real facing_x = 0.0f, facing_z = 0.0f;
+  for(size_t k = 0; k < r.members.size(); k++)
+  {
+    size_t i = indexOf(r.members[k]);
+    r.centre += Vector3(pos_x[i], pos_y[i], pos_z[i]);
+    facing_x += Math::Cos(yaw[i]);
+    facing_z += Math::Sin(yaw[i]);
+  }
+  if(!r.members.empty())
+    r.centre /= Real(r.members.size());
+  r.heading = Math::ATan2(facing_z, facing_x).valueRadians();
+  Real radius_2 = 0.0f;
+  for(size_t k = 0; k < r.members.size(); k++)
+  {
+    size_t i = indexOf(r.members[k]);
+    Real dx = pos_x[i] - r.centre.x, dz = pos_z[i] - r.centre.z;
+    radius_2 = std::max(radius_2, dx * dx + dz * dz);
+  }
+  r.radius = Math::Sqrt(radius_2);
+}
+
+bool SoldierStore::isRestful(const Regiment& r) const
+{
+  // Nobody is going anywhere, or has only just stopped
+  for(size_t k = 0; k < r.members.size(); k++)
+  {
+    size_t i = indexOf(r.members[k]);
+    if(state[i] != IDLING || !waypoints[i].isEmpty()
+    || (flags[i] & (MOVED | SETTLING)))
+      return false;
+  }
+  return true;
+}
+
+bool SoldierStore::isInContact(unsigned int r) const
+{
+  const Regiment& current = regiments[r];
+  Real enemy_reach = current.radius + ACQUIRE_RANGE,
+       friend_reach = current.radius + SEPARATION_RADIUS;
+
+  // Enemies close enough to fight, or anybody close enough to bump into
+  vector<unsigned int> nearby;
+  grid.queryRect(current.centre.x - enemy_reach, current.centre.z - enemy_reach,
+                 current.centre.x + enemy_reach, current.centre.z + enemy_reach,
+                 nearby);
+  for(size_t k = 0; k < nearby.size(); k++)
+  {
+    size_t i = nearby[k];
+    if(regiment[i] == r)
+      continue;
+    Real dx = pos_x[i] - current.centre.x, dz = pos_z[i] - current.centre.z;
+    Real reach = (faction[i] != current.faction) ? enemy_reach : friend_reach;
+    if(dx * dx + dz * dz < reach * reach)
+      return true;
+  }
+
+  // Sleeping enemies only show up as a whole
+  for(size_t other = 0; other < regiments.size(); other++)
+  {
+    const Regiment& enemy = regiments[other];
+    if(!enemy.asleep || enemy.members.empty()
+    || enemy.faction == current.faction)
+      continue;
+    Real reach = current.radius + enemy.radius + ACQUIRE_RANGE;
+    if(current.centre.squaredDistance(enemy.centre) < reach * reach)
+      return true;
+  }
+  return false;
+}
+
+void SoldierStore::sleep(unsigned int r)
+{
+  // Move everybody out past the awake Soldiers
+  SoldierHandleList& members = regiments[r].members;
+  for(size_t k = 0; k < members.size(); k++)
+  {
+    n_active--;
+    swapSoldiers(indexOf(members[k]), n_active);
+  }
+  regiments[r].asleep = true;
+  grid_dirty = dormant_dirty = true;
+}
+
+void SoldierStore::wake(unsigned int r)
+{
+  if(!regiments[r].asleep)
+    return;
+
+  // Move everybody back in with the awake Soldiers
+  SoldierHandleList& members = regiments[r].members;
+  for(size_t k = 0; k < members.size(); k++)
+  {
+    swapSoldiers(indexOf(members[k]), n_active);
+    n_active++;
+  }
+  regiments[r].asleep = false;
+  grid_dirty = dormant_dirty = true;
+}
+
+void SoldierStore::wakeSelected()
+{
+  // Waking moves Soldiers about, so find the Regiments first
+  vector<unsigned int> waking;
+  for(size_t i = n_active; i < size(); i++)
+    if((flags[i] & SELECTED) && regiment[i] != NONE)
+      waking.push_back(regiment[i]);
+  for(size_t k = 0; k < waking.size(); k++)
+    wake(waking[k]);
+}
+
+void SoldierStore::swapSoldiers(size_t i, size_t j)
+{
+  if(i == j)
+    return;
+
+  std::swap(slot_to_dense[dense_to_handle[i] & SLOT_MASK],
+            slot_to_dense[dense_to_handle[j] & SLOT_MASK]);
+  std::swap(dense_to_handle[i], dense_to_handle[j]);
+  std::swap(state[i], state[j]);
+  std::swap(flags[i], flags[j]);
+  std::swap(pos_x[i], pos_x[j]);
+  std::swap(pos_y[i], pos_y[j]);
+  std::swap(pos_z[i], pos_z[j]);
+  std::swap(dir_x[i], dir_x[j]);
+  std::swap(dir_z[i], dir_z[j]);
+  std::swap(dest_x[i], dest_x[j]);
+  std::swap(dest_z[i], dest_z[j]);
+  std::swap(distance_left[i], distance_left[j]);
+  std::swap(yaw[i], yaw[j]);
+  std::swap(prev_x[i], prev_x[j]);
+  std::swap(prev_y[i], prev_y[j]);
+  std::swap(prev_z[i], prev_z[j]);
+  std::swap(prev_yaw[i], prev_yaw[j]);
+  std::swap(waypoints[i], waypoints[j]);
+  std::swap(flow[i], flow[j]);
+  std::swap(faction[i], faction[j]);
+  std::swap(health[i], health[j]);
+  std::swap(target[i], target[j]);
+  std::swap(cooldown[i], cooldown[j]);
+  std::swap(regiment[i], regiment[j]);
+  std::swap(entities[i], entities[j]);
+  std::swap(nodes[i], nodes[j]);
+  std::swap(animations[i], animations[j]);
+}
+
+void SoldierStore::setSelectedAt(size_t i, bool _selected)
+{
+  if(_selected)
+    flags[i] |= SELECTED;
+  else
+    flags[i] &= ~SELECTED;
+  if(nodes[i])
+    nodes[i]->showBoundingBox(_selected);
+}
+
+void SoldierStore::separate(size_t begin, size_t end, Real max_push)
+{
+  // Other chunks are moving their Soldiers right now, so only look at where
+  // everybody was at the start of the tick: that is also what the grid holds
+  const Real radius_2 = SEPARATION_RADIUS * SEPARATION_RADIUS;
+  for(size_t i = begin; i < end; i++)
+  {
+    Real x = prev_x[i], z = prev_z[i], px = 0.0f, pz = 0.0f;
+    int col0, row0, col1, row1;
+    grid.getCell(x - SEPARATION_RADIUS, z - SEPARATION_RADIUS, col0, row0);
+    grid.getCell(x + SEPARATION_RADIUS, z + SEPARATION_RADIUS, col1, row1);
+    for(int row = row0; row <= row1; row++)
+    for(int col = col0; col <= col1; )
+    {
+      const unsigned int *first, *last;
+      col = grid.getRowItems(row, col, col1, first, last);
+      for(const unsigned int* j = first; j != last; j++)
+      {
+        if(*j == i)
+          continue;
+        Real dx = x - prev_x[*j], dz = z - prev_z[*j];
+        Real distance_2 = dx * dx + dz * dz;
+        if(distance_2 >= radius_2)
+          continue;
+
+        // Push apart in proportion to the overlap, sideways if on top
+        if(distance_2 > 0.0f)
+        {
+          Real distance = Math::Sqrt(distance_2);
+          Real overlap = (SEPARATION_RADIUS - distance) / distance;
+          px += dx * overlap;
+          pz += dz * overlap;
+        }
+        else
+          px += (i < *j) ? -SEPARATION_RADIUS : SEPARATION_RADIUS;
+      }
+    }
+
+    // Never shove anybody further than they could walk
+    px *= SEPARATION_STIFFNESS;
+    pz *= SEPARATION_STIFFNESS;
+    Real length_2 = px * px + pz * pz;
+    if(length_2 < SEPARATION_MIN_PUSH * SEPARATION_MIN_PUSH)
+      px = pz = 0.0f;
+    else if(length_2 > max_push * max_push)
+    {
+      Real scale = max_push / Math::Sqrt(length_2);
+      px *= scale;
+      pz *= scale;
+    }
+    push_x[i] = px;
+    push_z[i] = pz;
+  }
+}
+
+void SoldierStore::pickIn(const SpatialGrid& cells, size_t offset,
+                          const Ray& ray, size_t& best, Real& best_t) const
+{
+  // Only visit the cells under the ray
+  vector<SpatialGrid::RayCell> crossed;
+  cells.traceRay(ray, crossed);
+
+  const Vector3& o = ray.getOrigin();
+  const Vector3& d = ray.getDirection();
+  for(size_t c = 0; c < crossed.size(); c++)
+  {
+    // A Soldier overlapping this cell can stand in a neighbouring one
+    int col1 = crossed[c].col + 1;
+    for(int row = crossed[c].row - 1; row <= crossed[c].row + 1; row++)
+    for(int col = crossed[c].col - 1; col <= col1; )
+    {
+      const unsigned int *first, *last;
+      col = cells.getRowItems(row, col, col1, first, last);
+      for(const unsigned int* it = first; it != last; it++)
+      {
+        // Slab test against the box around the Soldier
+        size_t i = *it + offset;
+        Real lo[3] = { pos_x[i] - RADIUS, pos_y[i], pos_z[i] - RADIUS },
+             hi[3] = { pos_x[i] + RADIUS, pos_y[i] + HEIGHT, pos_z[i] + RADIUS };
+        Real t_near = 0.0f, t_far = best_t;
+        for(int axis = 0; axis < 3 && t_near <= t_far; axis++)
+        {
+          if(d[axis] == 0.0f)
+          {
+            if(o[axis] < lo[axis] || o[axis] > hi[axis])
+              t_near = Math::POS_INFINITY;
+            continue;
+          }
+          Real t0 = (lo[axis] - o[axis]) / d[axis],
+               t1 = (hi[axis] - o[axis]) / d[axis];
+          t_near = std::max(t_near, std::min(t0, t1));
+          t_far = std::min(t_far, std::max(t0, t1));
+        }
+        if(t_near <= t_far && t_near < best_t)
+        {
+          best = i;
+          best_t = t_near;
+        }
+      }
+    }
+
+    // Nothing in a later cell can be hit before the end of this one
+    if(best != NONE && best_t <= crossed[c].t_exit)
+      break;
+  }
+}
+
+void SoldierStore::updateGrid()
+{
+  if(n_active == 0)
+    grid.clear();
+  else
+    grid.build(&pos_x[0], &pos_z[0], n_active);
+  grid_dirty = false;
+}
+
+void SoldierStore::updateDormantGrid()
+{
+  // Only needed for picking and selection, so rebuilt when they ask
+  if(n_active == size())
+    dormant_grid.clear();
+  else
+    dormant_grid.build(&pos_x[n_active], &pos_z[n_active], size() - n_active);
+  dormant_dirty = false;
+}
@@ -0,0 +1,219 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SOLDIERSTORE_HPP_INCLUDED
+#define SOLDIERSTORE_HPP_INCLUDED
+
+#include <OgreSceneManager.h>
+#include <OgreEntity.h>
+
+#include <deque>
+#include <vector>
+
+#include "FactionIndex.hpp"
+#include "FlowFieldCache.hpp"
+#include "Formation.hpp"
+#include "HeightField.hpp"
+#include "JobSystem.hpp"
+#include "SpatialGrid.hpp"
+#include "WaypointPool.hpp"
+
+// Stable identifier of a Soldier: survives other Soldiers being destroyed, and
+// stops being valid when its own Soldier is, even once the slot is reused
+typedef unsigned int SoldierHandle;
+typedef std::vector<SoldierHandle> SoldierHandleList;
+typedef HashMap<Ogre::MovableObject*, SoldierHandle> SoldierEntityMap;
+
+class SoldierStore
+{
+  /// CONSTANTS
+public:
+  static const SoldierHandle NONE;
+private:
+  static const unsigned int SLOT_BITS;
+  static const SoldierHandle SLOT_MASK;
+  static const Ogre::Real WALK_SPEED;
+  static const Ogre::Real RADIUS, HEIGHT;
+  static const size_t TICK_GRAIN;
+  static const Ogre::Real FLOW_ARRIVAL_CELLS;
+  static const Ogre::Real SEPARATION_RADIUS, SEPARATION_STIFFNESS,
+                          SEPARATION_MIN_PUSH;
+  static const Ogre::Real ACQUIRE_RANGE;
+  static const unsigned int ACQUIRE_INTERVAL;
+  static const Ogre::Real MELEE_RANGE;
+  static const Ogre::Real MAX_HEALTH, ATTACK_DAMAGE, ATTACK_INTERVAL;
+
+  /// NESTING
+private:
+  enum State
+  {
+    IDLING, WALKING, ENGAGING, FIGHTING
+  };
+  enum Flag
+  {
+    SELECTED = 1,       // under the player's control
+    MOVED = 2,          // position changed during the last tick
+    SETTLING = 4,       // stopped moving, scene needs the final position
+    STATE_CHANGED = 8   // animation needs to be switched
+  };
+  // Soldiers spawned together. While idle and out of contact the whole
+  // Regiment sleeps, standing in for its members with an aggregate.
+  struct Regiment
+  {
+    SoldierHandleList members;
+    unsigned char faction;
+    bool asleep;
+    Ogre::Vector3 centre;
+    Ogre::Real radius, heading;
+  };
+  // Ticks a range of Soldiers on a worker thread
+  class TickJob : public JobSystem::Job
+  {
+  public:
+    SoldierStore* store;
+    Ogre::Real d_time;
+    const HeightField* terrain;
+    void run(size_t begin, size_t end);
+  };
+
+  /// ATTRIBUTES
+private:
+  // scene manager to attach Entities to, NULL when headless
+  Ogre::SceneManager* scene;
+  // shared paths for move orders, NULL to walk in straight lines
+  FlowFieldCache* paths;
+  // handle indirection: slots are stable, dense indices are packed. Handles
+  // carry their slot's generation, bumped each time the slot is freed.
+  std::vector<unsigned int> slot_to_dense;
+  std::vector<unsigned char> generations;
+  SoldierHandleList dense_to_handle;
+  std::deque<unsigned int> free_slots;  // Oldest first, to delay reuse
+  // per-Soldier data, one packed array per field, indexed by dense index.
+  // Awake Soldiers come first, those of sleeping Regiments after n_active.
+  size_t n_active;
+  std::vector<unsigned char> state;
+  std::vector<unsigned char> flags;
+  std::vector<Ogre::Real> pos_x, pos_y, pos_z;
+  std::vector<Ogre::Real> dir_x, dir_z;
+  std::vector<Ogre::Real> dest_x, dest_z;
+  std::vector<Ogre::Real> distance_left;
+  std::vector<Ogre::Real> yaw;
+  // placement at the previous tick, for interpolating between ticks
+  std::vector<Ogre::Real> prev_x, prev_y, prev_z, prev_yaw;
+  WaypointPool waypoint_pool;            // Overflow for long queues
+  std::vector<WaypointPool::Queue> waypoints;
+  std::vector<unsigned int> flow;       // Field followed to the destination
+  std::vector<unsigned char> faction;   // Soldiers fight other factions
+  std::vector<Ogre::Real> health;
+  SoldierHandleList target;             // Enemy being engaged, or NONE
+  std::vector<Ogre::Real> cooldown;     // Time until the next blow lands
+  std::vector<unsigned int> regiment;   // Index into regiments, or NONE
+  std::vector<Regiment> regiments;
+  // scene graph identifiers, NULL when headless
+  std::vector<Ogre::Entity*> entities;
+  std::vector<Ogre::SceneNode*> nodes;
+  std::vector<Ogre::AnimationState*> animations;
+  // side index used for picking
+  SoldierEntityMap entity_index;
+  // scratch space for Soldiers reaching their destination during a tick
+  std::vector<unsigned int> arrivals;
+  // scratch space for how far neighbours push each Soldier away this tick
+  std::vector<Ogre::Real> push_x, push_z;
+  // where everyone awake stood at the end of the last tick, by dense index
+  SpatialGrid grid;
+  bool grid_dirty;
+  // where everyone asleep stands, by dense index after n_active
+  SpatialGrid dormant_grid;
+  bool dormant_dirty;
+  // everybody sorted by faction at the start of the tick, to find enemies
+  FactionIndex enemies;
+  unsigned long n_ticks;
+  // scratch space for who each Soldier struck this tick, by dense index
+  std::vector<unsigned int> hits;
+
+  /// METHODS
+public:
+  // creation, destruction
+  SoldierStore();
+  virtual ~SoldierStore();
+  void setSceneManager(Ogre::SceneManager* _scene);
+  void setFlowFields(FlowFieldCache* _paths);
+  SoldierHandle create(Ogre::Vector3 position, unsigned char _faction = 0);
+  void spawnRegiment(size_t n, Ogre::Vector3 origin, const Formation& formation,
+                     const HeightField& terrain, unsigned char _faction = 0,
+                     SoldierHandleList* out = NULL);
+  void reserve(size_t n);
+  void destroy(SoldierHandle handle);
+  void clear();
+  // update
+  void tick(Ogre::Real d_time, const HeightField& terrain, JobSystem& jobs);
+  void applyToScene(Ogre::Real alpha, Ogre::Real d_time);
+  // control
+  void setSelected(SoldierHandle handle, bool _selected);
+  void deselectAll();
+  void selectInside(const Ogre::Vector3 corners[4]);
+  void addWaypoint(SoldierHandle handle, Ogre::Vector3 destination);
+  void addWaypointToSelected(Ogre::Vector3 destination);
+  void addFormationToSelected(Ogre::Vector3 destination,
+                              const Formation& formation);
+  // query
+  size_t size() const;
+  size_t getActiveCount() const;
+  bool isValid(SoldierHandle handle) const;
+  bool isSelected(SoldierHandle handle) const;
+  Ogre::Vector3 getPosition(SoldierHandle handle) const;
+  unsigned char getFaction(SoldierHandle handle) const;
+  Ogre::Real getHealth(SoldierHandle handle) const;
+  bool getRegiment(SoldierHandle handle, Ogre::Vector3& centre,
+                   Ogre::Real& heading, size_t& strength) const;
+  SoldierHandle find(Ogre::MovableObject* movable) const;
+  SoldierHandle pick(const Ogre::Ray& ray);
+  void getSelected(SoldierHandleList& out) const;
+  void getPositions(std::vector<Ogre::Vector3>& out, bool awake) const;
+
+  /// SUBROUTINES
+private:
+  size_t indexOf(SoldierHandle handle) const;
+  SoldierHandle append(Ogre::Real x, Ogre::Real y, Ogre::Real z, Ogre::Real _yaw,
+                       unsigned char _faction);
+  void attach(size_t i);
+  void detach(size_t i);
+  void tickRange(size_t begin, size_t end, Ogre::Real d_time,
+                 const HeightField& terrain);
+  void nextWaypoint(size_t i);
+  void clearWaypoints(size_t i);
+  void steer(size_t i);
+  void engage(size_t i, Ogre::Real d_time);
+  void resolveHits();
+  void updateRegiments();
+  void measureRegiment(Regiment& r) const;
+  bool isRestful(const Regiment& r) const;
+  bool isInContact(unsigned int r) const;
+  void sleep(unsigned int r);
+  void wake(unsigned int r);
+  void wakeSelected();
+  void swapSoldiers(size_t i, size_t j);
+  void separate(size_t begin, size_t end, Ogre::Real max_push);
+  void setSelectedAt(size_t i, bool _selected);
+  void pickIn(const SpatialGrid& cells, size_t offset, const Ogre::Ray& ray,
+              size_t& best, Ogre::Real& best_t) const;
+  void updateGrid();
+  void updateDormantGrid();
+};
+
+#endif // SOLDIERSTORE_HPP_INCLUDED
@@ -0,0 +1,319 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SpatialGrid.hpp"
+
+#include <algorithm>
+
+using namespace Ogre;
+using namespace std;
+
+/// CONSTANTS
+
+// Long enough that a neighbourhood's cells along a row are usually found in
+// one go, short enough that a lone Soldier doesn't cost many empty cells
+const int SpatialGrid::RUN_BITS = 4;
+const int SpatialGrid::RUN_LENGTH = 1 << RUN_BITS;
+
+/// CREATION, DESTRUCTION
+
+SpatialGrid::SpatialGrid(Real _cell_size) :
+cell_size(_cell_size),
+min_col(0), min_row(0), max_col(-1), max_row(-1),
+runs(),
+run_slots(),
+cell_start(),
+items(),
+item_cell()
+{
+}
+
+SpatialGrid::~SpatialGrid()
+{
+}
+
+void SpatialGrid::build(const Real* x, const Real* z, size_t count)
+{
+  if(count == 0)
+  {
+    clear();
+    return;
+  }
+
+  // Find the run and cell each item falls in, keeping last time's table size
+  runs.clear();
+  Run free_slot = { 0, 0, -1 };
+  run_slots.assign(std::max(run_slots.size(), (size_t)16), free_slot);
+  item_cell.resize(count);
+  getCell(x[0], z[0], min_col, min_row);
+  max_col = min_col;
+  max_row = min_row;
+  int run = -1;
+  for(size_t i = 0; i < count; i++)
+  {
+    int col, row;
+    getCell(x[i], z[i], col, row);
+    min_col = std::min(min_col, col);
+    max_col = std::max(max_col, col);
+    min_row = std::min(min_row, row);
+    max_row = std::max(max_row, row);
+
+    // Neighbours in the arrays are often neighbours on the ground, so try
+    // the last item's run first. Shifting rounds down, so negative columns
+    // land in the right run too.
+    int run_col = col >> RUN_BITS;
+    if(run < 0 || runs[run].col != run_col || runs[run].row != row)
+    {
+      run = findRun(run_col, row);
+      if(run < 0)
+        run = addRun(run_col, row);
+    }
+    item_cell[i] = run * RUN_LENGTH + (col & (RUN_LENGTH - 1));
+  }
+
+  // Counting sort: count the items in each cell...
+  cell_start.assign(runs.size() * RUN_LENGTH + 1, 0);
+  for(size_t i = 0; i < count; i++)
+    cell_start[item_cell[i] + 1]++;
+
+  // ... turn the counts into offsets...
+  for(size_t c = 1; c < cell_start.size(); c++)
+    cell_start[c] += cell_start[c - 1];
+
+  // ... and drop each item into its cell's range
+  items.resize(count);
+  vector<unsigned int> cursor(cell_start.begin(), cell_start.end() - 1);
+  for(size_t i = 0; i < count; i++)
+    items[cursor[item_cell[i]]++] = i;
+}
+
+void SpatialGrid::clear()
+{
+  min_col = min_row = 0;
+  max_col = max_row = -1;
+  runs.clear();
+  run_slots.clear();
+  cell_start.clear();
+  items.clear();
+}
+
+/// QUERY
+
+bool SpatialGrid::isEmpty() const
+{
+  return items.empty();
+}
+
+Real SpatialGrid::getCellSize() const
+{
+  return cell_size;
+}
+
+void SpatialGrid::getCell(Real x, Real z, int& col, int& row) const
+{
+  col = (int)Math::Floor(x / cell_size);
+  row = (int)Math::Floor(z / cell_size);
+}
+
+int SpatialGrid::getRowItems(int row, int col0, int col1,
+                             const unsigned int*& begin,
+                             const unsigned int*& end) const
+{
+  // The items in cells col0 to col1 of the row, as far as the end of col0's
+  // run: returns the column to carry on from
+  int next = ((col0 >> RUN_BITS) + 1) * RUN_LENGTH;
+  int run = isEmpty() ? -1 : findRun(col0 >> RUN_BITS, row);
+  if(run < 0)
+  {
+    begin = end = NULL;
+    return next;
+  }
+  size_t first = run * RUN_LENGTH + (col0 & (RUN_LENGTH - 1)),
+         last = run * RUN_LENGTH + (std::min(col1, next - 1) & (RUN_LENGTH - 1));
+  begin = &items[0] + cell_start[first];
+  end = &items[0] + cell_start[last + 1];
+  return next;
+}
+
+void SpatialGrid::traceRay(const Ray& ray, vector<RayCell>& out) const
+{
+  if(isEmpty())
+    return;
+
+  // Only the horizontal part of the ray matters to the grid. Trace a ring of
+  // border cells too, as items on the edge can overlap them.
+  Real ox = ray.getOrigin().x, oz = ray.getOrigin().z,
+       dx = ray.getDirection().x, dz = ray.getDirection().z;
+  Real lo_x = (min_col - 1) * cell_size, hi_x = (max_col + 2) * cell_size,
+       lo_z = (min_row - 1) * cell_size, hi_z = (max_row + 2) * cell_size;
+
+  // Clip the ray against the occupied bounds (slab test)
+  Real t_min = 0.0f, t_max = Math::POS_INFINITY;
+  if(dx == 0.0f)
+  {
+    if(ox < lo_x || ox > hi_x)
+      return;
+  }
+  else
+  {
+    Real t0 = (lo_x - ox) / dx, t1 = (hi_x - ox) / dx;
+    t_min = std::max(t_min, std::min(t0, t1));
+    t_max = std::min(t_max, std::max(t0, t1));
+  }
+  if(dz == 0.0f)
+  {
+    if(oz < lo_z || oz > hi_z)
+      return;
+  }
+  else
+  {
+    Real t0 = (lo_z - oz) / dz, t1 = (hi_z - oz) / dz;
+    t_min = std::max(t_min, std::min(t0, t1));
+    t_max = std::min(t_max, std::max(t0, t1));
+  }
+  if(t_min > t_max)
+    return;
+
+  // Start in the cell where the ray enters the bounds
+  int col = Math::Clamp((int)Math::Floor((ox + dx * t_min) / cell_size),
+                        min_col - 1, max_col + 1),
+      row = Math::Clamp((int)Math::Floor((oz + dz * t_min) / cell_size),
+                        min_row - 1, max_row + 1);
+
+  // Walk cell to cell, always crossing the nearest boundary (2D DDA)
+  int step_col = (dx > 0.0f) ? 1 : -1,
+      step_row = (dz > 0.0f) ? 1 : -1;
+  Real next_x = (col + (dx > 0.0f ? 1 : 0)) * cell_size,
+       next_z = (row + (dz > 0.0f ? 1 : 0)) * cell_size;
+  Real t_next_col = (dx != 0.0f) ? (next_x - ox) / dx : Math::POS_INFINITY,
+       t_next_row = (dz != 0.0f) ? (next_z - oz) / dz : Math::POS_INFINITY,
+       t_delta_col = (dx != 0.0f) ? cell_size / Math::Abs(dx) : Math::POS_INFINITY,
+       t_delta_row = (dz != 0.0f) ? cell_size / Math::Abs(dz) : Math::POS_INFINITY;
+
+  for(int n = (max_col - min_col) + (max_row - min_row) + 5; n > 0; n--)
+  {
+    RayCell cell = { col, row, std::min(t_max, std::min(t_next_col, t_next_row)) };
+    out.push_back(cell);
+    if(cell.t_exit >= t_max)
+      return;
+
+    if(t_next_col < t_next_row)
+    {
+      col += step_col;
+      t_next_col += t_delta_col;
+    }
+    else
+    {
+      row += step_row;
+      t_next_row += t_delta_row;
+    }
+    if(col < min_col - 1 || col > max_col + 1
+    || row < min_row - 1 || row > max_row + 1)
+      return;
+  }
+}
+
+void SpatialGrid::queryRect(Real x0, Real z0, Real x1, Real z1,
+                            vector<unsigned int>& out) const
+{
+  if(isEmpty())
+    return;
+
+  // Everything in the cells overlapping the rectangle is a candidate
+  int col0, row0, col1, row1;
+  getCell(std::min(x0, x1), std::min(z0, z1), col0, row0);
+  getCell(std::max(x0, x1), std::max(z0, z1), col1, row1);
+  col0 = std::max(col0, min_col);
+  row0 = std::max(row0, min_row);
+  col1 = std::min(col1, max_col);
+  row1 = std::min(row1, max_row);
+  if(col0 > col1 || row0 > row1)
+    return;
+
+  // Look the runs up one by one, unless there are fewer occupied runs than
+  // that to go through
+  int run_col0 = col0 >> RUN_BITS, run_col1 = col1 >> RUN_BITS;
+  if(double(run_col1 - run_col0 + 1) * double(row1 - row0 + 1) <= runs.size())
+  {
+    for(int row = row0; row <= row1; row++)
+      for(int col = col0; col <= col1; )
+      {
+        const unsigned int *first, *last;
+        col = getRowItems(row, col, col1, first, last);
+        out.insert(out.end(), first, last);
+      }
+  }
+  else
+  {
+    for(size_t r = 0; r < runs.size(); r++)
+    {
+      const Run& run = runs[r];
+      if(run.col < run_col0 || run.col > run_col1
+      || run.row < row0 || run.row > row1)
+        continue;
+      int first_col = run.col * RUN_LENGTH;
+      int c0 = std::max(col0, first_col) - first_col,
+          c1 = std::min(col1, first_col + RUN_LENGTH - 1) - first_col;
+      out.insert(out.end(), &items[0] + cell_start[r * RUN_LENGTH + c0],
+                            &items[0] + cell_start[r * RUN_LENGTH + c1 + 1]);
+    }
+  }
+}
+
+/// SUBROUTINES
+
+size_t SpatialGrid::hashRun(int col, int row) const
+{
+  unsigned int hash = (unsigned int)col * 0x9E3779B1u
+                    ^ (unsigned int)row * 0x85EBCA77u;
+  return (hash ^ (hash >> 15)) & (run_slots.size() - 1);
+}
+
+int SpatialGrid::findRun(int col, int row) const
+{
+  // Linear probing until the run or a free slot turns up
+  size_t mask = run_slots.size() - 1;
+  for(size_t slot = hashRun(col, row); run_slots[slot].index >= 0;
+      slot = (slot + 1) & mask)
+    if(run_slots[slot].col == col && run_slots[slot].row == row)
+      return run_slots[slot].index;
+  return -1;
+}
+
+int SpatialGrid::addRun(int col, int row)
+{
+  // Keep the table at most half full, rehashing everything when it grows
+  Run run = { col, row, (int)runs.size() };
+  runs.push_back(run);
+  size_t first = runs.size() - 1;
+  if(runs.size() * 2 > run_slots.size())
+  {
+    Run free_slot = { 0, 0, -1 };
+    run_slots.assign(run_slots.size() * 2, free_slot);
+    first = 0;
+  }
+  size_t mask = run_slots.size() - 1;
+  for(size_t r = first; r < runs.size(); r++)
+  {
+    size_t slot = hashRun(runs[r].col, runs[r].row);
+    while(run_slots[slot].index >= 0)
+      slot = (slot + 1) & mask;
+    run_slots[slot] = runs[r];
+  }
+  return run.index;
+}
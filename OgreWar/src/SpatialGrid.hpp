@@ -0,0 +1,89 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SPATIALGRID_HPP_INCLUDED
+#define SPATIALGRID_HPP_INCLUDED
+
+#include <vector>
+
+#include <Ogre.h>
+
+// Items sorted into square cells of a fixed size. Cells are kept in short
+// runs along each row, and only the runs with something in them are stored,
+// found by hashing their coordinates, so that crowds far apart cost no more
+// than crowds side by side.
+class SpatialGrid
+{
+  /// NESTING
+public:
+  // A cell crossed by a ray, and how far along the ray it is left behind.
+  // Includes the ring of empty cells just outside the occupied ones.
+  struct RayCell
+  {
+    int col, row;
+    Ogre::Real t_exit;
+  };
+private:
+  // An occupied run of cells, its column counted in runs rather than cells;
+  // in the hash table, an index of -1 marks a free slot
+  struct Run
+  {
+    int col, row;
+    int index;
+  };
+
+  /// CONSTANTS
+private:
+  static const int RUN_BITS;            // Runs are 2^RUN_BITS cells long
+  static const int RUN_LENGTH;
+
+  /// ATTRIBUTES
+private:
+  Ogre::Real cell_size;
+  int min_col, min_row, max_col, max_row; // Bounds of the occupied cells
+  std::vector<Run> runs;                // Occupied runs, in the order found
+  std::vector<Run> run_slots;           // The same, hashed by position
+  std::vector<unsigned int> cell_start; // Offsets into items, per cell + 1
+  std::vector<unsigned int> items;      // Item indices grouped by cell
+  std::vector<unsigned int> item_cell;  // Scratch: which cell each item is in
+
+  /// METHODS
+public:
+  // creation, destruction
+  SpatialGrid(Ogre::Real _cell_size);
+  virtual ~SpatialGrid();
+  void build(const Ogre::Real* x, const Ogre::Real* z, size_t count);
+  void clear();
+  // query
+  bool isEmpty() const;
+  Ogre::Real getCellSize() const;
+  void getCell(Ogre::Real x, Ogre::Real z, int& col, int& row) const;
+  int getRowItems(int row, int col0, int col1, const unsigned int*& begin,
+                  const unsigned int*& end) const;
+  void traceRay(const Ogre::Ray& ray, std::vector<RayCell>& out) const;
+  void queryRect(Ogre::Real x0, Ogre::Real z0, Ogre::Real x1, Ogre::Real z1,
+                 std::vector<unsigned int>& out) const;
+
+  /// SUBROUTINES
+private:
+  size_t hashRun(int col, int row) const;
+  int findRun(int col, int row) const;
+  int addRun(int col, int row);
+};
+
+#endif // SPATIALGRID_HPP_INCLUDED
@@ -0,0 +1,247 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "TerrainCache.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+using namespace Ogre;
+using namespace std;
+
+/// CREATION, DESTRUCTION
+
+TerrainCache::TerrainCache() :
+key(0),
+writes(),
+lock(),
+wake(),
+stopping(false),
+writer()
+{
+  resetKey();
+  writer = thread(&TerrainCache::writeLoop, this);
+}
+
+TerrainCache::~TerrainCache()
+{
+  // Finish what was queued: a page cut short would be loaded next time
+  {
+    lock_guard<mutex> guard(lock);
+    stopping = true;
+  }
+  wake.notify_all();
+  writer.join();
+}
+
+/// KEY
+
+void TerrainCache::resetKey()
+{
+  key = 14695981039346656037ULL;
+}
+
+void TerrainCache::hashBytes(const void* data, size_t size)
+{
+  const unsigned char* bytes = (const unsigned char*)data;
+  for(size_t i = 0; i < size; i++)
+    key = (key ^ bytes[i]) * 1099511628211ULL;
+}
+
+void TerrainCache::hashString(const String& s)
+{
+  // Hash the length too, so that neighbouring strings can't run together
+  size_t length = s.size();
+  hashBytes(&length, sizeof(length));
+  hashBytes(s.data(), length);
+}
+
+void TerrainCache::hashResource(const String& name, const String& group)
+{
+  // The contents, not the name or date: a file edited back is still cached
+  DataStreamPtr stream =
+    ResourceGroupManager::getSingleton().openResource(name, group);
+  char buffer[4096];
+  while(!stream->eof())
+    hashBytes(buffer, stream->read(buffer, sizeof(buffer)));
+}
+
+void TerrainCache::hashImportSettings(const Terrain::ImportData& settings)
+{
+  // Field by field, as the structure has padding and pointers in it
+  hashBytes(&settings.terrainAlign, sizeof(settings.terrainAlign));
+  hashBytes(&settings.terrainSize, sizeof(settings.terrainSize));
+  hashBytes(&settings.maxBatchSize, sizeof(settings.maxBatchSize));
+  hashBytes(&settings.minBatchSize, sizeof(settings.minBatchSize));
+  hashBytes(&settings.worldSize, sizeof(settings.worldSize));
+  hashBytes(&settings.inputScale, sizeof(settings.inputScale));
+  hashBytes(&settings.inputBias, sizeof(settings.inputBias));
+  for(size_t i = 0; i < settings.layerList.size(); i++)
+  {
+    const Terrain::LayerInstance& layer = settings.layerList[i];
+    hashBytes(&layer.worldSize, sizeof(layer.worldSize));
+    for(size_t t = 0; t < layer.textureNames.size(); t++)
+      hashString(layer.textureNames[t]);
+  }
+}
+
+String TerrainCache::getPrefix(const String& base) const
+{
+  char hex[17];
+  for(int i = 0; i < 16; i++)
+    hex[i] = "0123456789abcdef"[(key >> (60 - 4 * i)) & 0xf];
+  hex[16] = '\0';
+  return base + "_" + hex;
+}
+
+/// CONTROL
+
+void TerrainCache::save(Terrain* terrain, const String& filename,
+                        const String& group)
+{
+  // Serialise now, while the terrain can still be read from this thread
+  BufferStream* buffer = OGRE_NEW BufferStream();
+  DataStreamPtr stream(buffer);
+  {
+    StreamSerializer serializer(stream);
+    terrain->save(serializer);
+  }
+
+  // Hand the bytes over. The file is opened here, as the resource system
+  // belongs to this thread, but only the writer touches it from now on.
+  {
+    lock_guard<mutex> guard(lock);
+    writes.push_back(Write());
+    Write& write = writes.back();
+    write.filename = filename;
+    write.file = Root::getSingleton().createFileStream(filename, group, true);
+    write.data.swap(buffer->data);
+  }
+  wake.notify_one();
+}
+
+void TerrainCache::prune(const String& base, const String& extension,
+                         const String& group)
+{
+  // Pages saved under any other key can never be loaded again: delete them,
+  // or every edit to the heightmap would leave another map's worth behind
+  String current = getPrefix(base) + "_";
+  FileInfoListPtr files = ResourceGroupManager::getSingleton()
+    .findResourceFileInfo(group, base + "_*." + extension);
+  for(FileInfoList::iterator i = files->begin(); i != files->end(); i++)
+    if(i->archive->getType() == "FileSystem"
+    && !StringUtil::startsWith(i->basename, current, false)
+    && !isWriting(i->filename))
+      remove((i->archive->getName() + "/" + i->filename).c_str());
+}
+
+/// QUERY
+
+bool TerrainCache::isWriting(const String& filename) const
+{
+  lock_guard<mutex> guard(lock);
+  for(deque<Write>::const_iterator i = writes.begin(); i != writes.end(); i++)
+    if(i->filename == filename)
+      return true;
+  return false;
+}
+
+bool TerrainCache::isWriting() const
+{
+  lock_guard<mutex> guard(lock);
+  return !writes.empty();
+}
+
+/// SUBROUTINES
+
+void TerrainCache::writeLoop()
+{
+  unique_lock<mutex> guard(lock);
+  while(true)
+  {
+    while(writes.empty() && !stopping)
+      wake.wait(guard);
+    if(writes.empty())
+      return;
+
+    // Only the front is ever written, and it stays put while others queue
+    // behind it. It comes off the queue under the lock, as file handles
+    // are shared pointers.
+    Write& write = writes.front();
+    guard.unlock();
+    if(!write.data.empty())
+      write.file->write(&write.data[0], write.data.size());
+    write.file->close();
+    guard.lock();
+    writes.pop_front();
+  }
+}
+
+/// BUFFER STREAM
+
+TerrainCache::BufferStream::BufferStream() :
+DataStream(DataStream::WRITE),
+data(),
+position(0)
+{
+}
+
+size_t TerrainCache::BufferStream::read(void* buf, size_t count)
+{
+  count = std::min(count, data.size() - position);
+  if(count > 0)
+    memcpy(buf, &data[position], count);
+  position += count;
+  return count;
+}
+
+size_t TerrainCache::BufferStream::write(const void* buf, size_t count)
+{
+  // Grow as needed: chunk headers are written over once their size is known
+  if(position + count > data.size())
+    data.resize(position + count);
+  if(count > 0)
+    memcpy(&data[position], buf, count);
+  position += count;
+  mSize = data.size();
+  return count;
+}
+
+void TerrainCache::BufferStream::skip(long count)
+{
+  seek(position + count);
+}
+
+void TerrainCache::BufferStream::seek(size_t pos)
+{
+  position = std::min(pos, data.size());
+}
+
+size_t TerrainCache::BufferStream::tell() const
+{
+  return position;
+}
+
+bool TerrainCache::BufferStream::eof() const
+{
+  return position >= data.size();
+}
+
+void TerrainCache::BufferStream::close()
+{
+}
@@ -0,0 +1,98 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef TERRAINCACHE_HPP_INCLUDED
+#define TERRAINCACHE_HPP_INCLUDED
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <Ogre.h>
+#include <OGRE/Terrain/OgreTerrain.h>
+
+// Saved terrain pages, named after a hash of everything that went into them
+// so that changing the heightmap or the settings leaves the old files unused
+// until they are pruned.
+// Pages are serialised on the calling thread, since Terrain may need to read
+// its textures back, and written to disk on a thread of the cache's own.
+class TerrainCache
+{
+  /// NESTING
+private:
+  // An in-memory stream for Terrain::save to write into, chunk sizes and all
+  class BufferStream : public Ogre::DataStream
+  {
+  public:
+    std::vector<char> data;
+    size_t position;
+    BufferStream();
+    size_t read(void* buf, size_t count);
+    size_t write(const void* buf, size_t count);
+    void skip(long count);
+    void seek(size_t pos);
+    size_t tell() const;
+    bool eof() const;
+    void close();
+  };
+  // A serialised page waiting for the writer
+  struct Write
+  {
+    Ogre::String filename;
+    Ogre::DataStreamPtr file;
+    std::vector<char> data;
+  };
+
+  /// ATTRIBUTES
+private:
+  unsigned long long key;       // FNV-1a hash of the inputs so far
+  // writes still to finish, the oldest in front and in progress
+  std::deque<Write> writes;
+  mutable std::mutex lock;
+  std::condition_variable wake;
+  bool stopping;
+  std::thread writer;
+
+  /// METHODS
+public:
+  // creation, destruction
+  TerrainCache();
+  virtual ~TerrainCache();
+  // key
+  void resetKey();
+  void hashBytes(const void* data, size_t size);
+  void hashString(const Ogre::String& s);
+  void hashResource(const Ogre::String& name, const Ogre::String& group);
+  void hashImportSettings(const Ogre::Terrain::ImportData& settings);
+  Ogre::String getPrefix(const Ogre::String& base) const;
+  // control
+  void save(Ogre::Terrain* terrain, const Ogre::String& filename,
+            const Ogre::String& group);
+  void prune(const Ogre::String& base, const Ogre::String& extension,
+             const Ogre::String& group);
+  // query
+  bool isWriting(const Ogre::String& filename) const;
+  bool isWriting() const;
+
+  /// SUBROUTINES
+private:
+  void writeLoop();
+};
+
+#endif // TERRAINCACHE_HPP_INCLUDED
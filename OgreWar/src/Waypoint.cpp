@@ -22,8 +22,15 @@ using namespace Ogre;
 
 /// CREATION, DESTRUCTION
 
-Waypoint::Waypoint(Vector3 _position) :
-position(_position)
+Waypoint::Waypoint() :
+position(Vector3::ZERO),
+field(FlowFieldCache::NONE)
+{
+}
+
+Waypoint::Waypoint(Vector3 _position, unsigned int _field) :
+position(_position),
+field(_field)
 {
 }
 
@@ -33,3 +40,8 @@ Vector3 const& Waypoint::getPosition() const
 {
   return position;
 }
+
+unsigned int Waypoint::getField() const
+{
+  return field;
+}
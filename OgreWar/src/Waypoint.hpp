@@ -19,25 +19,25 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef WAYPOINT_HPP_INCLUDED
 #define WAYPOINT_HPP_INCLUDED
 
-#include <list>
-
-class Waypoint;
-typedef std::list<Waypoint> WaypointList;
-
 #include <Ogre.h>
+
+#include "FlowFieldCache.hpp"
 
 class Waypoint
 {
   /// ATTRIBUTES
 private:
   Ogre::Vector3 position;
+  unsigned int field;      // Flow field leading here, if any
 
   /// METHODS
 public:
   // creation, destruction
-  Waypoint(Ogre::Vector3 _position);
+  Waypoint();
+  Waypoint(Ogre::Vector3 _position, unsigned int _field = FlowFieldCache::NONE);
   // query
   Ogre::Vector3 const& getPosition() const;
+  unsigned int getField() const;
 };
 
 #endif // WAYPOINT_HPP_INCLUDED
@@ -0,0 +1,161 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "WaypointPool.hpp"
+
+using namespace std;
+
+/// CONSTANTS
+
+const size_t WaypointPool::RING_CAPACITY;
+const size_t WaypointPool::CHUNK_CAPACITY;
+const unsigned int WaypointPool::NO_CHUNK = (unsigned int)-1;
+
+/// CREATION, DESTRUCTION
+
+WaypointPool::Queue::Queue() :
+head(0),
+count(0),
+first(NO_CHUNK),
+last(NO_CHUNK)
+{
+}
+
+WaypointPool::WaypointPool() :
+chunks(),
+free_chunks(),
+free_lock()
+{
+}
+
+void WaypointPool::reserve(size_t n_chunks)
+{
+  // Grow the pool up front so that later overflows don't allocate
+  while(chunks.size() < n_chunks)
+  {
+    free_chunks.push_back(chunks.size());
+    chunks.push_back(Chunk());
+  }
+  free_chunks.reserve(chunks.capacity());
+}
+
+void WaypointPool::release()
+{
+  // Give all the memory back at once: no queue may still hold a chunk
+  std::vector<Chunk>().swap(chunks);
+  std::vector<unsigned int>().swap(free_chunks);
+}
+
+/// MODIFICATION
+
+void WaypointPool::push(Queue& queue, const Waypoint& waypoint)
+{
+  // Fill the ring first, as long as nothing is waiting in the overflow
+  if(queue.count < RING_CAPACITY && queue.first == NO_CHUNK)
+  {
+    queue.ring[(queue.head + queue.count) % RING_CAPACITY] = waypoint;
+    queue.count++;
+    return;
+  }
+
+  // Otherwise append to the last overflow chunk, starting a new one if full
+  if(queue.last == NO_CHUNK || chunks[queue.last].end == CHUNK_CAPACITY)
+  {
+    unsigned int chunk = acquireChunk();
+    if(queue.last == NO_CHUNK)
+      queue.first = chunk;
+    else
+      chunks[queue.last].next = chunk;
+    queue.last = chunk;
+  }
+  Chunk& tail = chunks[queue.last];
+  tail.items[tail.end++] = waypoint;
+}
+
+void WaypointPool::pop(Queue& queue)
+{
+  if(queue.isEmpty())
+    return;
+  queue.head = (queue.head + 1) % RING_CAPACITY;
+  queue.count--;
+
+  // Keep the oldest waypoints in the ring by pulling one in from overflow
+  if(queue.first == NO_CHUNK)
+    return;
+  Chunk& head = chunks[queue.first];
+  queue.ring[(queue.head + queue.count) % RING_CAPACITY] = head.items[head.begin++];
+  queue.count++;
+  if(head.begin == head.end)
+  {
+    unsigned int drained = queue.first;
+    queue.first = head.next;
+    if(queue.first == NO_CHUNK)
+      queue.last = NO_CHUNK;
+    releaseChunk(drained);
+  }
+}
+
+void WaypointPool::clear(Queue& queue)
+{
+  for(unsigned int chunk = queue.first; chunk != NO_CHUNK; )
+  {
+    unsigned int next = chunks[chunk].next;
+    releaseChunk(chunk);
+    chunk = next;
+  }
+  queue = Queue();
+}
+
+/// QUERY
+
+size_t WaypointPool::getChunkCount() const
+{
+  return chunks.size();
+}
+
+/// SUBROUTINES
+
+unsigned int WaypointPool::acquireChunk()
+{
+  // Recycle a drained chunk if there is one
+  unsigned int chunk;
+  if(free_chunks.empty())
+  {
+    chunk = chunks.size();
+    chunks.push_back(Chunk());
+    // Releasing must never reallocate, as it can happen during a tick
+    free_chunks.reserve(chunks.capacity());
+  }
+  else
+  {
+    chunk = free_chunks.back();
+    free_chunks.pop_back();
+  }
+
+  Chunk& c = chunks[chunk];
+  c.begin = c.end = 0;
+  c.next = NO_CHUNK;
+  return chunk;
+}
+
+void WaypointPool::releaseChunk(unsigned int chunk)
+{
+  // Pops from different worker threads can drain chunks at the same time
+  lock_guard<mutex> lock(free_lock);
+  free_chunks.push_back(chunk);
+}
@@ -0,0 +1,84 @@
+/*
+Open War: an open-source Total War clone, written in C++ using Ogre3D.
+Copyright (C) 2012 William James Dyce
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef WAYPOINTPOOL_HPP_INCLUDED
+#define WAYPOINTPOOL_HPP_INCLUDED
+
+#include <mutex>
+#include <vector>
+
+#include "Waypoint.hpp"
+
+// Storage for many small waypoint queues. Each queue keeps its first few
+// waypoints in a ring buffer held by value, so the common case never leaves
+// the owner's array; longer queues spill into chunks recycled by the pool.
+class WaypointPool
+{
+  /// CONSTANTS
+public:
+  static const size_t RING_CAPACITY = 4;
+  static const size_t CHUNK_CAPACITY = 16;
+  static const unsigned int NO_CHUNK;
+
+  /// NESTING
+public:
+  // Held by the owner, one per queue; the copy takes over the chunks
+  struct Queue
+  {
+    Waypoint ring[RING_CAPACITY];
+    unsigned char head, count;        // Oldest waypoints, always in the ring
+    unsigned int first, last;         // Overflow chunks, oldest first
+    Queue();
+    bool isEmpty() const { return count == 0; }
+    const Waypoint& front() const { return ring[head]; }
+  };
+private:
+  struct Chunk
+  {
+    Waypoint items[CHUNK_CAPACITY];
+    unsigned short begin, end;
+    unsigned int next;
+  };
+
+  /// ATTRIBUTES
+private:
+  std::vector<Chunk> chunks;
+  std::vector<unsigned int> free_chunks;
+  std::mutex free_lock;
+
+  /// METHODS
+public:
+  // creation, destruction
+  WaypointPool();
+  void reserve(size_t n_chunks);
+  void release();
+  // modification: push and clear may not run alongside pop, but pops on
+  // different queues may run in parallel
+  void push(Queue& queue, const Waypoint& waypoint);
+  void pop(Queue& queue);
+  void clear(Queue& queue);
+  // query
+  size_t getChunkCount() const;
+
+  /// SUBROUTINES
+private:
+  unsigned int acquireChunk();
+  void releaseChunk(unsigned int chunk);
+};
+
+#endif // WAYPOINTPOOL_HPP_INCLUDED
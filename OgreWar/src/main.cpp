@@ -18,18 +18,38 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <Ogre.h>
 
-#include "platform.h"           // needed or MAIN and ERROR
+#include <cstdlib>              // for atoi
+#include <cstring>              // for strcmp
+
+#include "platform.h"           // needed or MAIN, ARGC, ARGV and ERROR
 #include "Application.hpp"
+#include "Benchmark.hpp"
 
 using namespace std;
 using namespace Ogre;
 
 MAIN
 {
+  // Micro-benchmarks: OgreWar --benchmark <name> [soldiers] [ticks]
+  // Each sets up only what it measures, so no Application is made for them
+  if(ARGC > 1 && !strcmp(ARGV[1], "--benchmark"))
+  {
+    if(ARGC > 2 && Benchmark::run(ARGV[2], (ARGC > 3) ? atoi(ARGV[3]) : 100000,
+                                           (ARGC > 4) ? atoi(ARGV[4]) : 1000))
+      return EXIT_SUCCESS;
+    Benchmark::printUsage();
+    return EXIT_FAILURE;
+  }
+
   Application app;
   try
   {
-    app.go();
+    // Simulation only: OgreWar --headless [soldiers] [ticks]
+    if(ARGC > 1 && !strcmp(ARGV[1], "--headless"))
+      app.goHeadless((ARGC > 2) ? atoi(ARGV[2]) : 1000,
+                     (ARGC > 3) ? atoi(ARGV[3]) : 6000);
+    else
+      app.go();
 	}
 	catch(Ogre::Exception& e)
 	{
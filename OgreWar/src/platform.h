@@ -24,12 +24,16 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
     #include "windows.h"
     #define MAIN    \
         INT WINAPI WinMain(HINSTANCE hInst, HINSTANCE, LPSTR strCmdLine, INT)
+    #define ARGC __argc
+    #define ARGV __argv
     #define ERROR(msg)   \
         MessageBoxA(NULL, msg, "An exception has occurred!", \
             MB_OK | MB_ICONERROR | MB_TASKMODAL)
 #else
     #define MAIN    \
         int main(int argc, char **argv, char** envp)
+    #define ARGC argc
+    #define ARGV argv
     #define ERROR(msg)   \
         fprintf(stderr, "An exception has occurred: %s\n", msg)
 #endif